@@ -1,4 +1,5 @@
 #include "bsdetector.h"
+#include <cmath>
 
 
 const std::string BSDetector::VERSION = "1.3.0";
@@ -17,6 +18,7 @@ const int BSDetector::RESULT_INITIAL_TOO_FEW = 12;
 const int BSDetector::RESULT_INITIAL_TOO_SPARSE = 13;
 const int BSDetector::RESULT_INITIAL_TOO_MANY_OUTLIERS = 14;
 const int BSDetector::RESULT_INITIAL_CLOSE_ORIENTATION = 15;
+const int BSDetector::RESULT_INITIAL_OFF_AXIS = 16;
 const int BSDetector::RESULT_FINAL_NO_DETECTION = 21;
 const int BSDetector::RESULT_FINAL_TOO_FEW = 22;
 const int BSDetector::RESULT_FINAL_TOO_SPARSE = 23;
@@ -34,6 +36,14 @@ const int BSDetector::DEFAULT_FINAL_MIN_SIZE = 3;
 const int BSDetector::DEFAULT_FRAGMENT_MIN_SIZE = 5;
 const int BSDetector::DEFAULT_AUTO_SWEEPING_STEP = 5;
 const int BSDetector::PRELIM_MIN_HALF_WIDTH = 10;
+const int BSDetector::AXIS_SEED_TOLERANCE = 2;
+const int BSDetector::COARSE_SWEEPING_STRIDE = 8;
+const int BSDetector::ADAPTIVE_SWEEPING_STRIDE = 4;
+const char BSDetector::STROKE_UNSWEPT = 0;
+const char BSDetector::STROKE_FRUITLESS = 1;
+const char BSDetector::STROKE_FRUITFUL = 2;
+const int BSDetector::FAILURE_CELL_SIZE = 8;
+const int BSDetector::SEED_FILTER_SLOPE = 25;
 
 
 
@@ -65,6 +75,15 @@ BSDetector::BSDetector ()
   autoSweepingStep = DEFAULT_AUTO_SWEEPING_STEP;
   maxtrials = 0;
   nbtrials = 0;
+  axisSlope = 0;
+  timeBudget = 0;
+  truncated = false;
+  failureCacheOn = false;
+  nbskipped = 0;
+  seedFilterOn = false;
+  nbfiltered = 0;
+  adaptiveSweepOn = false;
+  nbstrokes = 0;
 
   bspre = NULL;
   bsini = NULL;
@@ -123,22 +142,15 @@ void BSDetector::detectAll ()
   freeMultiSelection ();
   gMap->setMasking (true);
   gMap->clearMask ();
+  detAreas.clear ();
+  detStrokes.clear ();
 
   // Runs the automatic detection sweep algorithm
-  bool isnext = true;
   nbtrials = 0;
-  int width = gMap->getWidth ();
-  int height = gMap->getHeight ();
-  for (int x = width / 2; isnext && x > 0; x -= autoSweepingStep)
-    isnext = detectMulti (Pt2i (x, 0), Pt2i (x, height - 1));
-  for (int x = width / 2 + autoSweepingStep;
-       isnext && x < width - 1; x += autoSweepingStep)
-    isnext = detectMulti (Pt2i (x, 0), Pt2i (x, height - 1));
-  for (int y = height / 2; isnext && y > 0; y -= autoSweepingStep)
-    isnext = detectMulti (Pt2i (0, y), Pt2i (width - 1, y));
-  for (int y = height / 2 + autoSweepingStep;
-       isnext && y < height - 1; y += autoSweepingStep)
-    isnext = detectMulti (Pt2i (0, y), Pt2i (width - 1, y));
+  startClock ();
+  resetDetectionCounters ();
+  resetFailureCache ();
+  sweepArea (0, 0, gMap->getWidth () - 1, gMap->getHeight () - 1);
 
   // Updates the selected segment for survey
   if (maxtrials > (int) (mbsf.size ())) maxtrials = 0;
@@ -160,6 +172,9 @@ void BSDetector::detectAllWithBalancedXY ()
   // Runs the automatic detection balanced sweep algorithm
   bool isnext = true;
   nbtrials = 0;
+  startClock ();
+  resetDetectionCounters ();
+  resetFailureCache ();
   int width = gMap->getWidth ();
   int height = gMap->getHeight ();
   int xg = width / 2, yb = height / 2;
@@ -201,6 +216,286 @@ void BSDetector::detectAllWithBalancedXY ()
 }
 
 
+void BSDetector::detectAllInAreas (
+                  const std::vector<std::pair<Pt2i, Pt2i> > &areas)
+{
+  // Initializes the multi-detection structures
+  autodet = true;
+  freeMultiSelection ();
+  gMap->setMasking (true);
+  if (&areas != &detAreas) detAreas = areas;
+  detStrokes.clear ();
+  int width = gMap->getWidth ();
+  int height = gMap->getHeight ();
+
+  // Clears the mask inside the areas and their dilation margin
+  int margin = (gMap->getMaskDilation () == 0 ? 0
+                : (gMap->getMaskDilation () <= 8 ? 1 : 2));
+  std::vector<std::pair<Pt2i, Pt2i> >::const_iterator it = detAreas.begin ();
+  while (it != detAreas.end ())
+  {
+    gMap->clearMask (it->first.x () - margin, it->first.y () - margin,
+                     it->second.x () + margin, it->second.y () + margin);
+    it ++;
+  }
+
+  // Runs the automatic detection sweep algorithm in each area
+  bool isnext = true;
+  nbtrials = 0;
+  startClock ();
+  resetDetectionCounters ();
+  resetFailureCache ();
+  it = detAreas.begin ();
+  while (isnext && it != detAreas.end ())
+  {
+    int xmin = (it->first.x () < 0 ? 0 : it->first.x ());
+    int ymin = (it->first.y () < 0 ? 0 : it->first.y ());
+    int xmax = (it->second.x () >= width ? width - 1 : it->second.x ());
+    int ymax = (it->second.y () >= height ? height - 1 : it->second.y ());
+    it ++;
+    if (xmax - xmin < BSTracker::MIN_SCAN || ymax - ymin < BSTracker::MIN_SCAN)
+      continue;
+
+    // Bounds the trackers to the area
+    int sx = xmax - xmin + 1;
+    int sy = ymax - ymin + 1;
+    if (prelimDetectionOn) bst0->setArea (xmin, ymin, sx, sy);
+    bst1->setArea (xmin, ymin, sx, sy);
+    bst2->setArea (xmin, ymin, sx, sy);
+
+    isnext = sweepArea (xmin, ymin, xmax, ymax);
+  }
+  if (prelimDetectionOn) bst0->setArea (0, 0, width, height);
+  bst1->setArea (0, 0, width, height);
+  bst2->setArea (0, 0, width, height);
+
+  // Updates the selected segment for survey
+  if (maxtrials > (int) (mbsf.size ())) maxtrials = 0;
+
+  // Filters the detection output using NFA measure
+  if (nfaf) nfaf->filter (mbsf, vbsf, rbsf);
+  gMap->setMasking (false);
+}
+
+
+void BSDetector::detectAllOnStrokes (
+                  const std::vector<std::pair<Pt2i, Pt2i> > &strokes)
+{
+  // Initializes the multi-detection structures
+  autodet = true;
+  freeMultiSelection ();
+  gMap->setMasking (true);
+  gMap->clearMask ();
+  detAreas.clear ();
+  if (&strokes != &detStrokes) detStrokes = strokes;
+  int width = gMap->getWidth ();
+  int height = gMap->getHeight ();
+
+  // Runs the multi-detection on each stroke clipped to the picture
+  bool isnext = true;
+  nbtrials = 0;
+  startClock ();
+  resetDetectionCounters ();
+  resetFailureCache ();
+  std::vector<std::pair<Pt2i, Pt2i> >::const_iterator it = detStrokes.begin ();
+  while (isnext && it != detStrokes.end ())
+  {
+    Pt2i p1 (it->first), p2 (it->second);
+    it ++;
+    p1.set (p1.x () < 0 ? 0 : (p1.x () >= width ? width - 1 : p1.x ()),
+            p1.y () < 0 ? 0 : (p1.y () >= height ? height - 1 : p1.y ()));
+    p2.set (p2.x () < 0 ? 0 : (p2.x () >= width ? width - 1 : p2.x ()),
+            p2.y () < 0 ? 0 : (p2.y () >= height ? height - 1 : p2.y ()));
+    if (p1.chessboard (p2) < BSTracker::MIN_SCAN) continue;
+    nbstrokes ++;
+    isnext = detectMulti (p1, p2);
+  }
+
+  // Updates the selected segment for survey
+  if (maxtrials > (int) (mbsf.size ())) maxtrials = 0;
+
+  // Filters the detection output using NFA measure
+  if (nfaf) nfaf->filter (mbsf, vbsf, rbsf);
+  gMap->setMasking (false);
+}
+
+
+bool BSDetector::sweepArea (int xmin, int ymin, int xmax, int ymax)
+{
+  bool isnext = true;
+  int xc = (xmin + xmax + 1) / 2;
+  int yc = (ymin + ymax + 1) / 2;
+  extractSweepSeeds (xmin, ymin, xmax, ymax);
+
+  // Sweeps the full step strokes only close to the coarse strokes successes
+  if (adaptiveSweepOn)
+  {
+    std::vector<char> colState (sweptCols.size (), STROKE_UNSWEPT);
+    std::vector<char> rowState (sweptRows.size (), STROKE_UNSWEPT);
+    for (int stride = ADAPTIVE_SWEEPING_STRIDE; isnext && stride != 0;
+         stride /= 2)
+    {
+      isnext = sweepLevel (sweptCols, colState, stride, true, ymin, ymax);
+      if (isnext)
+        isnext = sweepLevel (sweptRows, rowState, stride, false, xmin, xmax);
+    }
+    return (isnext);
+  }
+
+  // Under time budget, sweeps from coarse to fine strokes in both directions
+  if (timeBudget != 0)
+  {
+    for (int stride = COARSE_SWEEPING_STRIDE; isnext && stride != 0;
+         stride /= 2)
+    {
+      int sstep = stride * autoSweepingStep;
+      bool coarse = (stride == COARSE_SWEEPING_STRIDE);
+      for (int x = xc; isnext && x > xmin; x -= sstep)
+        if (coarse || ((xc - x) / autoSweepingStep) % (2 * stride) != 0)
+          isnext = sweepColumn (x, ymin, ymax);
+      for (int x = xc + sstep; isnext && x < xmax; x += sstep)
+        if (coarse || ((x - xc) / autoSweepingStep) % (2 * stride) != 0)
+          isnext = sweepColumn (x, ymin, ymax);
+      for (int y = yc; isnext && y > ymin; y -= sstep)
+        if (coarse || ((yc - y) / autoSweepingStep) % (2 * stride) != 0)
+          isnext = sweepRow (y, xmin, xmax);
+      for (int y = yc + sstep; isnext && y < ymax; y += sstep)
+        if (coarse || ((y - yc) / autoSweepingStep) % (2 * stride) != 0)
+          isnext = sweepRow (y, xmin, xmax);
+    }
+    return (isnext);
+  }
+
+  for (int x = xc; isnext && x > xmin; x -= autoSweepingStep)
+    isnext = sweepColumn (x, ymin, ymax);
+  for (int x = xc + autoSweepingStep;
+       isnext && x < xmax; x += autoSweepingStep)
+    isnext = sweepColumn (x, ymin, ymax);
+  for (int y = yc; isnext && y > ymin; y -= autoSweepingStep)
+    isnext = sweepRow (y, xmin, xmax);
+  for (int y = yc + autoSweepingStep;
+       isnext && y < ymax; y += autoSweepingStep)
+    isnext = sweepRow (y, xmin, xmax);
+  return (isnext);
+}
+
+
+void BSDetector::extractSweepSeeds (int xmin, int ymin, int xmax, int ymax)
+{
+  // Lists the swept columns and lines (same strokes as in sweepArea)
+  std::vector<int> &cols = sweptCols;
+  std::vector<int> &rows = sweptRows;
+  cols.clear ();
+  rows.clear ();
+  int xc = (xmin + xmax + 1) / 2;
+  int yc = (ymin + ymax + 1) / 2;
+  int x0 = (xc > xmin ? xc - ((xc - xmin - 1) / autoSweepingStep)
+                             * autoSweepingStep : xc + autoSweepingStep);
+  for (int x = x0; x < xmax; x += autoSweepingStep) cols.push_back (x);
+  int y0 = (yc > ymin ? yc - ((yc - ymin - 1) / autoSweepingStep)
+                             * autoSweepingStep : yc + autoSweepingStep);
+  for (int y = y0; y < ymax; y += autoSweepingStep) rows.push_back (y);
+
+  // Under time budget, seeds are searched stroke by stroke
+  sweepSeeds.clear ();
+  colSeeds.clear ();
+  rowSeeds.clear ();
+  if (timeBudget != 0) return;
+
+  // Gets their contrasted local max in bulk
+  std::vector<int> cfirst, rfirst;
+  gMap->columnLocalMax (sweepSeeds, cfirst, cols, ymin, ymax);
+  gMap->rowLocalMax (sweepSeeds, rfirst, rows, xmin, xmax);
+
+  // Indexes them by column and by line (empty for unswept ones)
+  colSeeds.assign (gMap->getWidth () + 1, 0);
+  int k = 0;
+  for (int x = 0; x <= gMap->getWidth (); x++)
+  {
+    if (k < (int) cols.size () && cols[k] < x) k++;
+    colSeeds[x] = cfirst[k];
+  }
+  rowSeeds.assign (gMap->getHeight () + 1, 0);
+  k = 0;
+  for (int y = 0; y <= gMap->getHeight (); y++)
+  {
+    if (k < (int) rows.size () && rows[k] < y) k++;
+    rowSeeds[y] = rfirst[k];
+  }
+}
+
+
+bool BSDetector::sweepLevel (const std::vector<int> &strokes,
+                             std::vector<char> &states, int stride,
+                             bool columns, int smin, int smax)
+{
+  bool isnext = true;
+  int n = (int) strokes.size ();
+  bool coarse = (stride == ADAPTIVE_SWEEPING_STRIDE);
+  for (int i = 0; isnext && i < n; i++)
+  {
+    if (states[i] != STROKE_UNSWEPT) continue;
+    if (coarse)
+    {
+      // Regularly spaced strokes, and the last one to bound the last band
+      if (i % stride != 0 && i != n - 1) continue;
+    }
+    else
+    {
+      // Middle strokes of the bands bounded by a successful stroke
+      if (i % (2 * stride) != stride) continue;
+      int inext = (i + stride < n ? i + stride : n - 1);
+      if (states[i - stride] != STROKE_FRUITFUL
+          && states[inext] != STROKE_FRUITFUL) continue;
+    }
+    int nbsegs = (int) (mbsf.size ());
+    isnext = (columns ? sweepColumn (strokes[i], smin, smax)
+                      : sweepRow (strokes[i], smin, smax));
+
+    // Short segments (text glyphs) found by the stroke are not significant
+    states[i] = STROKE_FRUITLESS;
+    for (int k = nbsegs; k < (int) (mbsf.size ()); k++)
+      if (2 * mbsf[k]->extent () >= stride * autoSweepingStep)
+        states[i] = STROKE_FRUITFUL;
+  }
+  return (isnext);
+}
+
+
+bool BSDetector::sweepColumn (int x, int ymin, int ymax)
+{
+  nbstrokes ++;
+  if (colSeeds.empty ()) return (detectMulti (Pt2i (x, ymin), Pt2i (x, ymax)));
+  int nlm = colSeeds[x + 1] - colSeeds[x];
+  int *locmax = new int[nlm + 1];
+  for (int i = 0; i < nlm; i++) locmax[i] = sweepSeeds[colSeeds[x] + i];
+  Pt2i start (x, ymin);
+  Vr2i dir (0, 1);
+  nlm = gMap->keepFreeSortedMax (locmax, nlm, start, dir);
+  bool isnext = detectSeeds (start, Pt2i (x, ymax), locmax, nlm,
+                             std::vector<Pt2i> (), start, dir);
+  delete [] locmax;
+  return (isnext);
+}
+
+
+bool BSDetector::sweepRow (int y, int xmin, int xmax)
+{
+  nbstrokes ++;
+  if (rowSeeds.empty ()) return (detectMulti (Pt2i (xmin, y), Pt2i (xmax, y)));
+  int nlm = rowSeeds[y + 1] - rowSeeds[y];
+  int *locmax = new int[nlm + 1];
+  for (int i = 0; i < nlm; i++) locmax[i] = sweepSeeds[rowSeeds[y] + i];
+  Pt2i start (xmin, y);
+  Vr2i dir (1, 0);
+  nlm = gMap->keepFreeSortedMax (locmax, nlm, start, dir);
+  bool isnext = detectSeeds (start, Pt2i (xmax, y), locmax, nlm,
+                             std::vector<Pt2i> (), start, dir);
+  delete [] locmax;
+  return (isnext);
+}
+
+
 void BSDetector::detectSelection (const Pt2i &p1, const Pt2i &p2)
 {
   autodet = false;
@@ -212,6 +507,9 @@ void BSDetector::detectSelection (const Pt2i &p1, const Pt2i &p2)
     gMap->setMasking (true);
     gMap->clearMask ();
     nbtrials = 0;
+    startClock ();
+    resetDetectionCounters ();
+    resetFailureCache ();
     detectMulti (p1, p2);
 
     // Updates the selected segment for survey
@@ -226,7 +524,12 @@ void BSDetector::detectSelection (const Pt2i &p1, const Pt2i &p2)
 
 void BSDetector::redetect ()
 {
-  if (autodet) detectAll ();
+  if (autodet)
+  {
+    if (! detStrokes.empty ()) detectAllOnStrokes (detStrokes);
+    else if (detAreas.empty ()) detectAll ();
+    else detectAllInAreas (detAreas);
+  }
   else detectSelection (inip1, inip2);
 }
 
@@ -239,43 +542,161 @@ void BSDetector::freeMultiSelection ()
 }
 
 
+void BSDetector::startClock ()
+{
+  truncated = false;
+  if (timeBudget != 0) startTime = std::chrono::steady_clock::now ();
+}
+
+
+void BSDetector::resetDetectionCounters ()
+{
+  nbskipped = 0;
+  nbfiltered = 0;
+  nbstrokes = 0;
+}
+
+
+void BSDetector::resetFailureCache ()
+{
+  if (failureCacheOn)
+  {
+    int cw = (gMap->getWidth () + FAILURE_CELL_SIZE - 1) / FAILURE_CELL_SIZE;
+    int ch = (gMap->getHeight () + FAILURE_CELL_SIZE - 1) / FAILURE_CELL_SIZE;
+    failures.assign (cw * ch, 0);
+  }
+  else failures.clear ();
+}
+
+
+bool BSDetector::locateFailure (const Pt2i &pt, const Vr2i &stroke,
+                                int &cell, uint32_t &bit) const
+{
+  int axis = (stroke.x () == 0 ? 0 : (stroke.y () == 0 ? 1 : -1));
+  if (axis < 0 || failures.empty ()) return false;
+  int cw = (gMap->getWidth () + FAILURE_CELL_SIZE - 1) / FAILURE_CELL_SIZE;
+  cell = (pt.y () / FAILURE_CELL_SIZE) * cw + pt.x () / FAILURE_CELL_SIZE;
+
+  // Gradient direction quantized in eight sectors
+  Vr2i grad = gMap->getValue (pt);
+  int sector = ((int) floor ((atan2 ((double) grad.y (), (double) grad.x ())
+                              + M_PI) * 4 / M_PI)) & 7;
+  bit = ((uint32_t) 1) << (sector + 8 * (2 * axis
+                                         + (oppositeGradientDir ? 1 : 0)));
+  return true;
+}
+
+
+bool BSDetector::isOverdue ()
+{
+  if (! truncated)
+    truncated = (std::chrono::duration_cast<std::chrono::milliseconds> (
+                   std::chrono::steady_clock::now () - startTime).count ()
+                 >= timeBudget);
+  return (truncated);
+}
+
+
 bool BSDetector::detectMulti (const Pt2i &p1, const Pt2i &p2)
 {
   // Finds and sorts local max of gradient magnitude along the input stroke
   std::vector<Pt2i> pts;
-  p1.draw (pts, p2);
-  int *locmax = new int[pts.size ()];
-  int nlm = gMap->localMax (locmax, pts);
+  int *locmax = NULL;
+  int nlm = 0;
+  Pt2i runStart (p1);
+  Vr2i runDir (0, 0);
+  if (p1.x () == p2.x () || p1.y () == p2.y ())
+  {
+    // Axis-aligned stroke : the map is read along a row or a column
+    //   (pixels ordered as by Pt2i::draw)
+    int n = 1;
+    if (p1.x () != p2.x ())
+    {
+      if (p2.x () < p1.x ()) runStart.set (p2);
+      runDir.set (1, 0);
+      n += (p1.x () < p2.x () ? p2.x () - p1.x () : p1.x () - p2.x ());
+    }
+    else if (p1.y () != p2.y ())
+    {
+      runDir.set (0, p1.y () < p2.y () ? 1 : -1);
+      n += (p1.y () < p2.y () ? p2.y () - p1.y () : p1.y () - p2.y ());
+    }
+    locmax = new int[n];
+    nlm = gMap->localMax (locmax, runStart, runDir, n);
+  }
+  else
+  {
+    p1.draw (pts, p2);
+    locmax = new int[pts.size ()];
+    nlm = gMap->localMax (locmax, pts);
+  }
 
   // Detects a blurred segment for each local max
+  bool isnext = detectSeeds (p1, p2, locmax, nlm, pts, runStart, runDir);
+  delete [] locmax;
+  return (isnext);
+}
+
+
+bool BSDetector::detectSeeds (const Pt2i &p1, const Pt2i &p2,
+                              const int *locmax, int nlm,
+                              const std::vector<Pt2i> &pts,
+                              const Pt2i &runStart, const Vr2i &runDir)
+{
   bool isnext = true;
+  Vr2i stroke = p1.vectorTo (p2);
   for (int i = 0; isnext && i < nlm; i++)
   {
-    Pt2i ptstart = pts.at (locmax[i]);
-    if (gMap->isFree (ptstart))
+    Pt2i ptstart = (pts.empty () ?
+                    Pt2i (runStart.x () + locmax[i] * runDir.x (),
+                          runStart.y () + locmax[i] * runDir.y ()) :
+                    pts.at (locmax[i]));
+    if (timeBudget != 0 && isOverdue ()) isnext = false;
+    else if (gMap->isFree (ptstart)
+        && (axisSlope == 0 || isAxisAlignedSeed (ptstart, stroke)))
     {
-      // Handles opposite edge orientations
-      bool savedOppDir = oppositeGradientDir;
-      oppositeGradientDir = false;
-      int nbDets = (gMap->isOrientationConstraintOn () ? 2 : 1);
-      if (singleMultiOn) nbDets = 1;
-      while (isnext && nbDets != 0)
+      // Skips the seeds on edges running along the stroke
+      if (seedFilterOn && ! prelimDetectionOn
+          && ! isCrossingSeed (ptstart, stroke))
+        nbfiltered ++;
+      else
       {
-        // Detects a blurred segment
-        if (detectSingle (p1, p2, true, ptstart) == RESULT_OK)
+        // Handles opposite edge orientations
+        bool savedOppDir = oppositeGradientDir;
+        oppositeGradientDir = false;
+        int nbDets = (gMap->isOrientationConstraintOn () ? 2 : 1);
+        if (singleMultiOn) nbDets = 1;
+        while (isnext && nbDets != 0)
         {
-          gMap->setMask (bsf->getAllPoints ());
-          mbsf.push_back (bsf);
-          bsf = NULL; // to avoid BS deletion
-
-          // Interrupts the detection when the selected segment is reached
-          if ((int) (mbsf.size ()) == maxtrials) isnext = false;
+          // Skips the seeds known to fail at initial step
+          int fcell = 0;
+          uint32_t fbit = 0;
+          bool cached = (failureCacheOn
+                         && locateFailure (ptstart, stroke, fcell, fbit));
+          if (cached && (failures[fcell] & fbit) != 0) nbskipped ++;
+          else
+          {
+            // Detects a blurred segment
+            int res = detectSingle (p1, p2, true, ptstart);
+            if (res == RESULT_OK)
+            {
+              gMap->setMask (bsf->getAllPoints ());
+              mbsf.push_back (bsf);
+              bsf = NULL; // to avoid BS deletion
+
+              // Interrupts the detection when the selected segment is reached
+              if ((int) (mbsf.size ()) == maxtrials) isnext = false;
+            }
+            else if (cached && res >= RESULT_PRELIM_NO_DETECTION
+                     && res <= RESULT_INITIAL_OFF_AXIS)
+              failures[fcell] |= fbit;
+            nbtrials ++;
+          }
+          oppositeGradientDir = ! oppositeGradientDir;
+          nbDets --;
         }
-        oppositeGradientDir = ! oppositeGradientDir;
-        nbDets --;
-        nbtrials ++;
+        oppositeGradientDir = savedOppDir;
       }
-      oppositeGradientDir = savedOppDir;
     }
   }
   return (isnext);
@@ -361,6 +782,9 @@ int BSDetector::detectSingle (const Pt2i &p1, const Pt2i &p2,
   Vr2i bsinidir = bsini->getSupportVector();
   if (bsinidir.orientedAs (inip1.vectorTo (inip2)))
     return RESULT_INITIAL_CLOSE_ORIENTATION;
+  if (axisSlope != 0
+      && ! bsinidir.isAxisAligned (AXIS_SEED_TOLERANCE * axisSlope))
+    return RESULT_INITIAL_OFF_AXIS;
   
   // Gradient reference selection
   //-----------------------------
@@ -400,6 +824,45 @@ int BSDetector::detectSingle (const Pt2i &p1, const Pt2i &p2,
 }
 
 
+bool BSDetector::isAxisAlignedSeed (const Pt2i &pt, const Vr2i &stroke) const
+{
+  // The edge is orthogonal to the gradient: a horizontal segment crossing
+  // a vertical stroke has a near vertical gradient, and conversely
+  Vr2i grad = gMap->getValue (pt);
+  int gx = (grad.x () < 0 ? - grad.x () : grad.x ());
+  int gy = (grad.y () < 0 ? - grad.y () : grad.y ());
+  int slope = AXIS_SEED_TOLERANCE * axisSlope;
+  if (stroke.x () == 0) return (100 * gx <= slope * gy);
+  if (stroke.y () == 0) return (100 * gy <= slope * gx);
+  return (grad.isAxisAligned (slope));
+}
+
+
+bool BSDetector::isCrossingSeed (const Pt2i &pt, const Vr2i &stroke) const
+{
+  // Gradient summed over the 3x3 neighbourhood, with the seed orientation
+  Vr2i grad = gMap->getValue (pt);
+  int64_t gx = 0, gy = 0;
+  for (int j = pt.y () - 1; j <= pt.y () + 1; j++)
+    for (int i = pt.x () - 1; i <= pt.x () + 1; i++)
+      if (i >= 0 && j >= 0 && i < gMap->getWidth () && j < gMap->getHeight ())
+      {
+        Vr2i g = gMap->getValue (i, j);
+        if (g.x () * grad.x () + g.y () * grad.y () < 0) g.invert ();
+        gx += g.x ();
+        gy += g.y ();
+      }
+
+  // The edge is orthogonal to the gradient: it runs along the stroke
+  //   if the gradient is nearly orthogonal to the stroke
+  int64_t along = gx * stroke.x () + gy * stroke.y ();
+  int64_t across = gx * stroke.y () - gy * stroke.x ();
+  if (along < 0) along = - along;
+  if (across < 0) across = - across;
+  return (100 * along > SEED_FILTER_SLOPE * across);
+}
+
+
 BlurredSegment *BSDetector::getBlurredSegment (int step) const
 {
   if (step == STEP_PRELIM) return (bspre);
@@ -525,6 +988,14 @@ void BSDetector::setFinalScansRecord (bool status)
 }
 
 
+void BSDetector::setAxisAlignedWindow (double angle)
+{
+  axisSlope = (angle > 0. ? (int) (100 * tan (angle * M_PI / 180) + 0.5) : 0);
+  if (angle > 0. && axisSlope == 0) axisSlope = 1;
+  bst2->setAxisWindow (axisSlope);
+}
+
+
 void BSDetector::switchNFA ()
 {
   nfaOn = ! nfaOn;
@@ -4,6 +4,7 @@
 #include "bstracker.h"
 #include "nfafilter.h"
 #include <string>
+#include <chrono>
 
 
 /** 
@@ -44,6 +45,8 @@ public:
   static const int RESULT_INITIAL_TOO_MANY_OUTLIERS;
   /** Extraction result : initial detection of a closely oriented segment. */
   static const int RESULT_INITIAL_CLOSE_ORIENTATION;
+  /** Extraction result : initial detection out of the axis-aligned window. */
+  static const int RESULT_INITIAL_OFF_AXIS;
   /** Extraction result : no final detection (bsf == NULL). */
   static const int RESULT_FINAL_NO_DETECTION;
   /** Extraction result : too few points at final detection. */
@@ -93,6 +96,23 @@ public:
    */
   void detectAllWithBalancedXY ();
 
+  /**
+   * \brief Detects all blurred segments in given areas of the picture.
+   * Sweeping strokes, seeds and tracked segments are bounded to the areas.
+   * Parses X direction first, then Y direction, in each area.
+   * @param areas Rectangular areas as pairs of (top-left, bottom-right) points.
+   */
+  void detectAllInAreas (const std::vector<std::pair<Pt2i, Pt2i> > &areas);
+
+  /**
+   * \brief Detects all blurred segments crossing given strokes.
+   * Used instead of the blind sweep when the segments are approximately
+   *   located in advance (e.g. rulings of bilevel pictures).
+   * The strokes are clipped to the picture and processed in the given order.
+   * @param strokes Strokes as pairs of end points.
+   */
+  void detectAllOnStrokes (const std::vector<std::pair<Pt2i, Pt2i> > &strokes);
+
   /**
    * \brief Detects blurred segments between two input points.
    * @param p1 First input point.
@@ -299,6 +319,25 @@ public:
    */
   inline void switchMultiSelection () { multiSelection = ! multiSelection; }
 
+  /**
+   * \brief Returns whether detection is restricted to axis-aligned segments.
+   */
+  inline bool isAxisAlignedModeOn () const { return (axisSlope != 0); }
+
+  /**
+   * \brief Returns the orientation window of the axis-aligned mode.
+   * The window is given by the tangent of its half angle, in percent.
+   */
+  inline int axisAlignedWindow () const { return axisSlope; }
+
+  /**
+   * \brief Restricts the detection to segments close to X or Y axis.
+   * Seeds with incompatible gradient direction are not tracked,
+   *   and tracking is aborted when the segment leaves the window.
+   * @param angle Window half angle in degrees (0 to detect all orientations).
+   */
+  void setAxisAlignedWindow (double angle);
+
   /**
    * \brief Returns the scan lines at final step.
    */
@@ -478,6 +517,84 @@ public:
    */
   inline void resetMaxDetections () { maxtrials = 0; }
 
+  /**
+   * \brief Returns the time budget of multi-detections in ms (0 if illimited).
+   */
+  inline int getTimeBudget () const { return timeBudget; }
+
+  /**
+   * \brief Sets the time budget of multi-detections.
+   * When the budget is exhausted, the sweep is stopped and the segments
+   *   already found are kept. Sweeping strokes are then processed from
+   *   coarse to fine spacing so that a partial result covers the picture.
+   * @param ms Time budget in milliseconds (0 if illimited).
+   */
+  inline void setTimeBudget (int ms) { timeBudget = (ms < 0 ? 0 : ms); }
+
+  /**
+   * \brief Checks whether last multi-detection was stopped by the time budget.
+   */
+  inline bool isTruncated () const { return truncated; }
+
+  /**
+   * \brief Returns whether failed seeds are cached in multi-detections.
+   */
+  inline bool isFailureCacheOn () const { return failureCacheOn; }
+
+  /**
+   * \brief Switches on or off the failed seeds cache.
+   * When set, a seed is not tried if a seed of the same sweep direction,
+   *   edge polarity and gradient direction already failed at the initial
+   *   step in the same neighbourhood.
+   */
+  inline void switchFailureCache () { failureCacheOn = ! failureCacheOn; }
+
+  /**
+   * \brief Returns the count of trials skipped by the failure cache
+   *   in the last multi-detection.
+   */
+  inline int countOfSkippedTrials () const { return (nbskipped); }
+
+  /**
+   * \brief Returns whether seeds are pre-filtered on their gradient direction.
+   */
+  inline bool isSeedFilterOn () const { return seedFilterOn; }
+
+  /**
+   * \brief Switches on or off the seed pre-filter.
+   * When set, a seed the local gradient of which indicates an edge running
+   *   along the input stroke is not tracked, as the initial segment would
+   *   be rejected by the orientation test.
+   * Not applied with the preliminary detection, which changes the stroke.
+   */
+  inline void switchSeedFilter () { seedFilterOn = ! seedFilterOn; }
+
+  /**
+   * \brief Returns the count of seeds rejected by the seed pre-filter
+   *   in the last multi-detection.
+   */
+  inline int countOfFilteredSeeds () const { return (nbfiltered); }
+
+  /**
+   * \brief Returns whether automatic detections use adaptive sweeps.
+   */
+  inline bool isAdaptiveSweepOn () const { return adaptiveSweepOn; }
+
+  /**
+   * \brief Switches on or off the adaptive sweeps.
+   * When set, a coarse sweep with strokes spaced by ADAPTIVE_SWEEPING_STRIDE
+   *   steps is first run, then the bands between coarse strokes are swept
+   *   from coarse to fine spacing only around the strokes that found
+   *   segments longer than half the strokes spacing. Otherwise, all the
+   *   strokes are swept at the sweeping step.
+   */
+  inline void switchAdaptiveSweep () { adaptiveSweepOn = ! adaptiveSweepOn; }
+
+  /**
+   * \brief Returns the count of strokes swept in the last automatic detection.
+   */
+  inline int countOfSweptStrokes () const { return (nbstrokes); }
+
   /**
    * \brief Gets the last detection inputs.
    * @param step Detection step.
@@ -515,8 +632,24 @@ private :
   static const int DEFAULT_FRAGMENT_MIN_SIZE;
   /** Default value of the stroke sweeping step for automatic detections. */
   static const int DEFAULT_AUTO_SWEEPING_STEP;
+  /** Initial spacing (in sweeping steps) of coarse to fine sweeps. */
+  static const int COARSE_SWEEPING_STRIDE;
+  /** Initial spacing (in sweeping steps) of adaptive sweeps. */
+  static const int ADAPTIVE_SWEEPING_STRIDE;
+  /** Sweep state of a stroke not swept yet. */
+  static const char STROKE_UNSWEPT;
+  /** Sweep state of a stroke that found no long enough segment. */
+  static const char STROKE_FRUITLESS;
+  /** Sweep state of a stroke that found long enough segments. */
+  static const char STROKE_FRUITFUL;
+  /** Side of the failure cache cells in pixels. */
+  static const int FAILURE_CELL_SIZE;
+  /** Maximal slope of an edge along the stroke for the seed pre-filter. */
+  static const int SEED_FILTER_SLOPE;
   /** Default value for the preliminary stroke half length. */
   static const int PRELIM_MIN_HALF_WIDTH;
+  /** Widening of the axis-aligned window for seeds and initial segments. */
+  static const int AXIS_SEED_TOLERANCE;
 
 
   /** Processed gradient map. */
@@ -601,9 +734,47 @@ private :
   int autoSweepingStep;
   /** Result of the blurred segment extraction. */
   int resultValue;
+  /** Axis-aligned orientation window (tangent in percent, 0 if unused). */
+  int axisSlope;
 
   /** Maximum number of trials in a multi-detection (for survey). */
   int maxtrials;    // DVPT
+  /** Time budget of a multi-detection in milliseconds (0 if illimited). */
+  int timeBudget;
+  /** Start time of the last multi-detection. */
+  std::chrono::steady_clock::time_point startTime;
+  /** Interruption status of the last multi-detection by the time budget. */
+  bool truncated;
+  /** Failed seeds cache modality. */
+  bool failureCacheOn;
+  /** Failed seeds by cell (one bit by sweep axis, polarity and direction). */
+  std::vector<uint32_t> failures;
+  /** Count of trials skipped by the failure cache. */
+  int nbskipped;
+  /** Seed pre-filter modality. */
+  bool seedFilterOn;
+  /** Count of seeds rejected by the seed pre-filter. */
+  int nbfiltered;
+  /** Adaptive sweeps modality. */
+  bool adaptiveSweepOn;
+  /** Count of strokes swept in the last automatic detection. */
+  int nbstrokes;
+  /** Areas of the last automatic detection (whole picture if empty). */
+  std::vector<std::pair<Pt2i, Pt2i> > detAreas;
+  /** Strokes of the last seeded detection (sweep detection if empty). */
+  std::vector<std::pair<Pt2i, Pt2i> > detStrokes;
+  /** Contrasted local max of the sweep strokes of the swept area. */
+  std::vector<int> sweepSeeds;
+  /** Start of each column stroke seeds in sweepSeeds (by column),
+   *  empty when the seeds are searched stroke by stroke. */
+  std::vector<int> colSeeds;
+  /** Start of each row stroke seeds in sweepSeeds (by line),
+   *  empty when the seeds are searched stroke by stroke. */
+  std::vector<int> rowSeeds;
+  /** Columns swept in the swept area. */
+  std::vector<int> sweptCols;
+  /** Lines swept in the swept area. */
+  std::vector<int> sweptRows;
 
 
   /**
@@ -611,6 +782,38 @@ private :
    */
   void freeMultiSelection ();
 
+  /**
+   * \brief Starts the time budget of a multi-detection.
+   */
+  void startClock ();
+
+  /**
+   * \brief Checks and records whether the time budget is exhausted.
+   */
+  bool isOverdue ();
+
+  /**
+   * \brief Clears the counters of skipped trials, filtered seeds and swept
+   *   strokes.
+   */
+  void resetDetectionCounters ();
+
+  /**
+   * \brief Clears the failed seeds cache.
+   */
+  void resetFailureCache ();
+
+  /**
+   * \brief Locates a seed in the failure cache.
+   * Returns false if the seed can not be cached (oblique stroke).
+   * @param pt Seed position.
+   * @param stroke Input stroke vector.
+   * @param cell Returned cache cell index.
+   * @param bit Returned seed bit in the cache cell.
+   */
+  bool locateFailure (const Pt2i &pt, const Vr2i &stroke,
+                      int &cell, uint32_t &bit) const;
+
   /**
    * \brief Detects all blurred segments between two input points.
    *   Returns the continuation modality.
@@ -619,5 +822,95 @@ private :
    */
   bool detectMulti (const Pt2i &p1, const Pt2i &p2);
 
+  /**
+   * \brief Detects all blurred segments from seeds found along a stroke.
+   *   Returns the continuation modality.
+   * @param p1 First input point.
+   * @param p2 Second input point.
+   * @param locmax Seed indices along the stroke, sorted by magnitude.
+   * @param nlm Count of seeds.
+   * @param pts Stroke pixels (empty for an axis-aligned run).
+   * @param runStart First pixel of the axis-aligned run.
+   * @param runDir Unit step of the axis-aligned run.
+   */
+  bool detectSeeds (const Pt2i &p1, const Pt2i &p2, const int *locmax,
+                    int nlm, const std::vector<Pt2i> &pts,
+                    const Pt2i &runStart, const Vr2i &runDir);
+
+  /**
+   * \brief Extracts in bulk the seeds of all the sweep strokes of an area.
+   * Seeds of the columns and lines swept by sweepArea are searched in two
+   *   passes over the gradient map, instead of one scan per stroke.
+   * Under time budget, only the strokes are listed: the passes would cover
+   *   the whole area before any deadline check.
+   * @param xmin Left column of the area.
+   * @param ymin Lower line of the area.
+   * @param xmax Right column of the area.
+   * @param ymax Upper line of the area.
+   */
+  void extractSweepSeeds (int xmin, int ymin, int xmax, int ymax);
+
+  /**
+   * \brief Detects all blurred segments along a swept column.
+   *   Returns the continuation modality.
+   * @param x Column of the stroke.
+   * @param ymin Lower line of the stroke.
+   * @param ymax Upper line of the stroke.
+   */
+  bool sweepColumn (int x, int ymin, int ymax);
+
+  /**
+   * \brief Detects all blurred segments along a swept line.
+   *   Returns the continuation modality.
+   * @param y Line of the stroke.
+   * @param xmin Left column of the stroke.
+   * @param xmax Right column of the stroke.
+   */
+  bool sweepRow (int y, int xmin, int xmax);
+
+  /**
+   * \brief Sweeps the strokes of one level of an adaptive sweep.
+   *   Returns the continuation modality.
+   * At the coarse level, one stroke every stride strokes is swept.
+   *   At finer levels, the middle stroke of a band is swept only if one
+   *   of the band bounding strokes found a segment longer than half the
+   *   level spacing.
+   * @param strokes Positions of the columns or lines to sweep.
+   * @param states Sweep state of each stroke, updated.
+   * @param stride Spacing of the level strokes (in sweeping steps).
+   * @param columns Sweep of columns if true, of lines otherwise.
+   * @param smin Start of the strokes.
+   * @param smax End of the strokes.
+   */
+  bool sweepLevel (const std::vector<int> &strokes, std::vector<char> &states,
+                   int stride, bool columns, int smin, int smax);
+
+  /**
+   * \brief Detects all blurred segments crossing an area with sweeping strokes.
+   *   Returns the continuation modality.
+   * @param xmin Left column of the area.
+   * @param ymin Lower line of the area.
+   * @param xmax Right column of the area.
+   * @param ymax Upper line of the area.
+   */
+  bool sweepArea (int xmin, int ymin, int xmax, int ymax);
+
+  /**
+   * \brief Checks whether a seed may start an axis-aligned segment.
+   * Only the segments crossing the stroke are considered.
+   * @param pt Seed point.
+   * @param stroke Direction of the stroke the seed was found on.
+   */
+  bool isAxisAlignedSeed (const Pt2i &pt, const Vr2i &stroke) const;
+
+  /**
+   * \brief Checks whether a seed may start a segment crossing the stroke.
+   * The gradient is summed over the seed neighbourhood and the edge slope
+   *   relatively to the stroke is compared to SEED_FILTER_SLOPE (percent).
+   * @param pt Seed point.
+   * @param stroke Direction of the stroke the seed was found on.
+   */
+  bool isCrossingSeed (const Pt2i &pt, const Vr2i &stroke) const;
+
 };
 #endif
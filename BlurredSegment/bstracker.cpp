@@ -13,6 +13,7 @@ const int BSTracker::FAILURE_NO_START = 1;
 const int BSTracker::FAILURE_IMAGE_BOUND_ON_RIGHT = 2;
 const int BSTracker::FAILURE_IMAGE_BOUND_ON_LEFT = 4;
 const int BSTracker::FAILURE_LOST_ORIENTATION = 32;
+const int BSTracker::FAILURE_OFF_AXIS = 64;
 
 
 
@@ -26,6 +27,7 @@ BSTracker::BSTracker ()
   fittingDelay = DEFAULT_FITTING_DELAY;
   assignedThicknessControlDelay = DEFAULT_ASSIGNED_THICKNESS_CONTROL_DELAY;
   recordScans = false;
+  axisSlope = 0;
 
   gMap = NULL;
   cand = new int[1]; // to avoid systematic tests
@@ -73,7 +75,7 @@ BlurredSegment *BSTracker::fastTrack (const Pt2i &p1, const Pt2i &p2,
   std::vector<Pt2i> pix;
   if (ds->first (pix) < MIN_SCAN)
   {
-    delete ds;
+    scanp.releaseScanner (ds);
     return NULL;
   }
   if (recordScans)
@@ -92,7 +94,7 @@ BlurredSegment *BSTracker::fastTrack (const Pt2i &p1, const Pt2i &p2,
     candide = gMap->largestIn (pix);
     if (candide == -1)
     {
-      delete ds;
+      scanp.releaseScanner (ds);
       return NULL;
     }
     pfirst.set (pix.at (candide));
@@ -175,7 +177,7 @@ BlurredSegment *BSTracker::fastTrack (const Pt2i &p1, const Pt2i &p2,
       }
     }
   }
-  delete ds;
+  scanp.releaseScanner (ds);
 
   // Validates (regenerates) and returns the blurred segment
   BlurredSegment *bs = bsp.endOfBirth ();
@@ -215,7 +217,7 @@ BlurredSegment *BSTracker::fineTrack (const Pt2i &center, const Vr2i &scandir,
   std::vector<Pt2i> pix;
   if (ds->first (pix) < MIN_SCAN)
   {
-    delete ds;
+    scanp.releaseScanner (ds);
     fail_status = FAILURE_NO_START;
     return NULL;
   }
@@ -230,7 +232,7 @@ BlurredSegment *BSTracker::fineTrack (const Pt2i &center, const Vr2i &scandir,
   int nbc = gMap->localMax (cand, pix, normal);
   if (nbc == 0)
   {
-    delete ds;
+    scanp.releaseScanner (ds);
     fail_status = FAILURE_NO_START;
     return NULL;
   }
@@ -284,6 +286,14 @@ BlurredSegment *BSTracker::fineTrack (const Pt2i &center, const Vr2i &scandir,
       int ppa, ppb, ppc;
       bsp.getLine()->getCentralLine (ppa, ppb, ppc);
       ds->bindTo (ppa, ppb, ppc);
+
+      // Stops the detection if the segment leaves the axis-aligned window
+      if (axisSlope != 0 && ! Vr2i (ppb, - ppa).isAxisAligned (axisSlope))
+      {
+        scanningLeft = false;
+        scanningRight = false;
+        fail_status += FAILURE_OFF_AXIS;
+      }
     }
 
     // Extends on right
@@ -392,7 +402,8 @@ BlurredSegment *BSTracker::fineTrack (const Pt2i &center, const Vr2i &scandir,
   }
   if (rstart) bsp.removeRight (rstart);
   if (lstart) bsp.removeLeft (lstart);
-  delete ds;
+  scanp.releaseScanner (ds);
+  if (fail_status & FAILURE_OFF_AXIS) return NULL;
 
   // Validates (regenerates) and returns the blurred segment
   BlurredSegment *bs = bsp.endOfBirth ();
@@ -39,6 +39,16 @@ public:
    */
   void setGradientMap (VMap *data);
 
+  /**
+   * \brief Restricts the scans to a sub-area of the gradient map.
+   * @param x0 Left column of the area.
+   * @param y0 Lower line of the area.
+   * @param sizex Area width.
+   * @param sizey Area height.
+   */
+  inline void setArea (int x0, int y0, int sizex, int sizey) {
+    scanp.setArea (x0, y0, sizex, sizey); }
+
   /**
    * \brief Builds and returns a blurred segment from only gradient maximum.
    * @param p1 Initial stroke start point.
@@ -65,6 +75,19 @@ public:
                              int bsMaxWidth, int acceptedLacks,
                              const Vr2i &gref);
 
+  /**
+   * \brief Returns the axis-aligned orientation window (0 if unconstrained).
+   * The window is given by the tangent of its half angle, in percent.
+   */
+  inline int getAxisWindow () const { return axisSlope; }
+
+  /**
+   * \brief Restricts fine tracking to segments close to X or Y axis.
+   * Tracking is aborted as soon as the segment leaves the window.
+   * @param slope Tangent of the window half angle, in percent (0 for none).
+   */
+  inline void setAxisWindow (int slope) { axisSlope = (slope > 0 ? slope : 0); }
+
   /**
    * \brief Returns the proximity test status.
    */
@@ -155,6 +178,8 @@ private :
   static const int FAILURE_IMAGE_BOUND_ON_LEFT;
   /** Segment stop information : lost orientation at dynamical reset start. */
   static const int FAILURE_LOST_ORIENTATION;
+  /** Segment stop information : axis-aligned orientation window left. */
+  static const int FAILURE_OFF_AXIS;
 
 
   /** Scanned map left bound. */
@@ -190,6 +215,8 @@ private :
   int fittingDelay;
   /** Count of stable point insertion before activation of ATC. */
   int assignedThicknessControlDelay;
+  /** Axis-aligned orientation window (tangent in percent, 0 if unused). */
+  int axisSlope;
 
   /** Status of the proximity constraint used for fast tracking. */
   bool proxTestOff;   // DVPT
@@ -0,0 +1,333 @@
+#include "tileddetector.h"
+#include <cmath>
+#include <algorithm>
+
+
+const int TiledDetector::BYTES_PER_PIXEL = 8;
+const int TiledDetector::DEFAULT_HALO = 64;
+const int TiledDetector::MIN_TILE_SIZE = 128;
+const int TiledDetector::BORDER_MARGIN = 3;
+const int TiledDetector::STITCH_DISTANCE = 3;
+const int TiledDetector::STITCH_GAP = 4;
+const int TiledDetector::STITCH_SLOPE = 5;
+
+
+
+TiledDetector::TiledDetector ()
+{
+  tileMap = NULL;
+  memoryBudget = 0;
+  halo = DEFAULT_HALO;
+  nbtiles = 0;
+  nbskipped = 0;
+  nbfiltered = 0;
+  truncated = false;
+}
+
+
+TiledDetector::~TiledDetector ()
+{
+  if (tileMap != NULL) delete tileMap;
+}
+
+
+int TiledDetector::tileSize (int width, int height) const
+{
+  int side = (width > height ? width : height);
+  if (memoryBudget != 0)
+  {
+    double pixels = (memoryBudget * 1024. * 1024.) / BYTES_PER_PIXEL;
+    int core = (int) sqrt (pixels) - 2 * halo;
+    if (core < MIN_TILE_SIZE) core = MIN_TILE_SIZE;
+    if (core < side) side = core;
+  }
+  return (side);
+}
+
+
+void TiledDetector::detectAll (const unsigned char *data,
+                               int width, int height, int stride)
+{
+  detectAllInAreas (data, width, height, stride,
+                    std::vector<std::pair<Pt2i, Pt2i> > ());
+}
+
+
+void TiledDetector::detectAllInAreas (const unsigned char *data,
+                       int width, int height, int stride,
+                       const std::vector<std::pair<Pt2i, Pt2i> > &areas)
+{
+  segs.clear ();
+  sizes.clear ();
+  tiles.clear ();
+  opens.clear ();
+  nbtiles = 0;
+  nbskipped = 0;
+  nbfiltered = 0;
+  truncated = false;
+
+  // The detector time budget is shared by all the tiles
+  int budget = detector.getTimeBudget ();
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now ();
+
+  int tsize = tileSize (width, height);
+  int ntx = (width + tsize - 1) / tsize;
+  int nty = (height + tsize - 1) / tsize;
+  for (int ty = 0; ty < nty; ty++)
+    for (int tx = 0; tx < ntx; tx++)
+    {
+      // Tile core and extended window
+      int cxmin = tx * tsize, cymin = ty * tsize;
+      int cxmax = std::min (cxmin + tsize, width) - 1;
+      int cymax = std::min (cymin + tsize, height) - 1;
+      int wxmin = std::max (cxmin - halo, 0);
+      int wymin = std::max (cymin - halo, 0);
+      int wxmax = std::min (cxmax + halo, width - 1);
+      int wymax = std::min (cymax + halo, height - 1);
+      int ww = wxmax - wxmin + 1, wh = wymax - wymin + 1;
+
+      // Areas met by the tile, in window coordinates
+      std::vector<std::pair<Pt2i, Pt2i> > tareas;
+      bool inside = areas.empty ();
+      std::vector<std::pair<Pt2i, Pt2i> >::const_iterator it = areas.begin ();
+      while (it != areas.end ())
+      {
+        int xmin = std::max (it->first.x (), wxmin);
+        int ymin = std::max (it->first.y (), wymin);
+        int xmax = std::min (it->second.x (), wxmax);
+        int ymax = std::min (it->second.y (), wymax);
+        if (xmin <= xmax && ymin <= ymax)
+        {
+          tareas.push_back (std::pair<Pt2i, Pt2i> (
+                              Pt2i (xmin - wxmin, ymin - wymin),
+                              Pt2i (xmax - wxmin, ymax - wymin)));
+          if (xmin <= cxmax && xmax >= cxmin && ymin <= cymax && ymax >= cymin)
+            inside = true;
+        }
+        it ++;
+      }
+      if (! inside) continue;
+      if (budget != 0)
+      {
+        int left = budget - (int) (std::chrono::duration_cast<
+                     std::chrono::milliseconds> (
+                       std::chrono::steady_clock::now () - start).count ());
+        if (left <= 0)
+        {
+          truncated = true;
+          continue;
+        }
+        detector.setTimeBudget (left);
+      }
+
+      // Builds the tile gradient map (the previous one is released first)
+      if (tileMap != NULL) delete tileMap;
+      tileMap = NULL;
+      unsigned char *tile = new unsigned char[ww * wh];
+      for (int j = 0; j < wh; j++)
+        std::copy (data + (wymin + j) * stride + wxmin,
+                   data + (wymin + j) * stride + wxmin + ww, tile + j * ww);
+      tileMap = new VMap (ww, wh, tile, VMap::TYPE_SOBEL_5X5);
+      delete [] tile;
+
+      // Detects the tile segments
+      detector.setGradientMap (tileMap);
+      if (areas.empty ()) detector.detectAll ();
+      else detector.detectAllInAreas (tareas);
+      if (detector.isTruncated ()) truncated = true;
+      nbskipped += detector.countOfSkippedTrials ();
+      nbfiltered += detector.countOfFilteredSeeds ();
+      nbtiles ++;
+
+      // Keeps the segments centered in the tile core
+      std::vector<BlurredSegment *> bss = detector.getBlurredSegments ();
+      std::vector<BlurredSegment *>::const_iterator bit = bss.begin ();
+      while (bit != bss.end ())
+      {
+        Pt2i lp = (*bit)->getLastLeft ();
+        Pt2i rp = (*bit)->getLastRight ();
+        int mx = wxmin + (lp.x () + rp.x ()) / 2;
+        int my = wymin + (lp.y () + rp.y ()) / 2;
+        if (mx >= cxmin && mx <= cxmax && my >= cymin && my <= cymax)
+        {
+          int xmin = std::min (lp.x (), rp.x ());
+          int ymin = std::min (lp.y (), rp.y ());
+          int xmax = std::max (lp.x (), rp.x ());
+          int ymax = std::max (lp.y (), rp.y ());
+          segs.push_back (std::pair<Pt2i, Pt2i> (
+                            Pt2i (lp.x () + wxmin, lp.y () + wymin),
+                            Pt2i (rp.x () + wxmin, rp.y () + wymin)));
+          sizes.push_back ((*bit)->size ());
+          tiles.push_back (ty * ntx + tx);
+          opens.push_back (
+            (wxmin != 0 && xmin < BORDER_MARGIN)
+            || (wymin != 0 && ymin < BORDER_MARGIN)
+            || (wxmax != width - 1 && xmax >= ww - BORDER_MARGIN)
+            || (wymax != height - 1 && ymax >= wh - BORDER_MARGIN));
+        }
+        bit ++;
+      }
+    }
+
+  detector.setTimeBudget (budget);
+
+  if (nbtiles > 1) stitch (ntx, nty);
+}
+
+
+bool TiledDetector::areStitchable (int i, int j) const
+{
+  // The longest fragment provides the reference line
+  if (segs[i].first.vectorTo(segs[i].second).norm2 ()
+      < segs[j].first.vectorTo(segs[j].second).norm2 ()) std::swap (i, j);
+  const Pt2i &a = segs[i].first;
+  double dax = segs[i].second.x () - a.x ();
+  double day = segs[i].second.y () - a.y ();
+  double dbx = segs[j].second.x () - segs[j].first.x ();
+  double dby = segs[j].second.y () - segs[j].first.y ();
+  double la = sqrt (dax * dax + day * day);
+  if (la == 0.) return false;
+
+  // Close directions
+  double dot = dax * dbx + day * dby;
+  double cross = dax * dby - day * dbx;
+  if (100 * fabs (cross) > STITCH_SLOPE * fabs (dot)) return false;
+
+  // Both ends of the second fragment close to the reference line
+  double c1x = segs[j].first.x () - a.x (), c1y = segs[j].first.y () - a.y ();
+  double c2x = segs[j].second.x () - a.x (), c2y = segs[j].second.y () - a.y ();
+  if (fabs (dax * c1y - day * c1x) > STITCH_DISTANCE * la
+      || fabs (dax * c2y - day * c2x) > STITCH_DISTANCE * la) return false;
+
+  // Overlapping or close projections on the reference line
+  double t1 = (dax * c1x + day * c1y) / la;
+  double t2 = (dax * c2x + day * c2y) / la;
+  return (std::min (t1, t2) <= la + STITCH_GAP
+          && std::max (t1, t2) >= - STITCH_GAP);
+}
+
+
+void TiledDetector::stitch (int ntx, int nty)
+{
+  int n = (int) (segs.size ());
+
+  // Fragments by tile
+  std::vector<std::vector<int> > byTile (ntx * nty);
+  for (int i = 0; i < n; i++) byTile[tiles[i]].push_back (i);
+
+  // Groups stitchable fragments of neighbour tiles (union-find)
+  std::vector<int> root (n);
+  for (int i = 0; i < n; i++) root[i] = i;
+  for (int i = 0; i < n; i++)
+  {
+    if (! opens[i]) continue;
+    int tx = tiles[i] % ntx, ty = tiles[i] / ntx;
+    for (int ny = std::max (ty - 1, 0); ny <= std::min (ty + 1, nty - 1); ny++)
+      for (int nx = std::max (tx - 1, 0); nx <= std::min (tx + 1, ntx - 1);
+           nx++)
+      {
+        std::vector<int>::const_iterator it = byTile[ny * ntx + nx].begin ();
+        while (it != byTile[ny * ntx + nx].end ())
+        {
+          int j = *it++;
+          if (j == i || (opens[j] && j < i)) continue;
+          int ri = i, rj = j;
+          while (root[ri] != ri) ri = root[ri];
+          while (root[rj] != rj) rj = root[rj];
+          if (ri != rj && areStitchable (i, j))
+          {
+            if (ri < rj) root[rj] = ri;
+            else root[ri] = rj;
+          }
+        }
+      }
+  }
+
+  // Fragments of each group, the group being ordered by its first fragment
+  std::vector<std::vector<int> > groups (n);
+  for (int i = 0; i < n; i++)
+  {
+    int r = i;
+    while (root[r] != r) r = root[r];
+    groups[r].push_back (i);
+  }
+
+  std::vector<std::pair<Pt2i, Pt2i> > ssegs;
+  std::vector<int> ssizes;
+  std::vector<int> stiles;
+  std::vector<bool> sopens;
+  for (int g = 0; g < n; g++)
+  {
+    if (groups[g].empty ()) continue;
+    if (groups[g].size () == 1)
+    {
+      ssegs.push_back (segs[g]);
+      ssizes.push_back (sizes[g]);
+      stiles.push_back (tiles[g]);
+      sopens.push_back (opens[g]);
+      continue;
+    }
+
+    // Projects the fragments on the longest one
+    int ref = groups[g][0];
+    std::vector<int>::const_iterator it = groups[g].begin ();
+    while (it != groups[g].end ())
+    {
+      if (segs[*it].first.vectorTo(segs[*it].second).norm2 ()
+          > segs[ref].first.vectorTo(segs[ref].second).norm2 ()) ref = *it;
+      it ++;
+    }
+    const Pt2i &a = segs[ref].first;
+    double dax = segs[ref].second.x () - a.x ();
+    double day = segs[ref].second.y () - a.y ();
+    std::vector<std::pair<double, double> > spans;
+    std::vector<int> npts;
+    double tmin = 0., tmax = 0.;
+    Pt2i pmin (a), pmax (a);
+    for (it = groups[g].begin (); it != groups[g].end (); it ++)
+    {
+      const Pt2i &p1 = segs[*it].first;
+      const Pt2i &p2 = segs[*it].second;
+      double t1 = dax * (p1.x () - a.x ()) + day * (p1.y () - a.y ());
+      double t2 = dax * (p2.x () - a.x ()) + day * (p2.y () - a.y ());
+      if (t1 < tmin) { tmin = t1; pmin.set (p1); }
+      if (t2 < tmin) { tmin = t2; pmin.set (p2); }
+      if (t1 > tmax) { tmax = t1; pmax.set (p1); }
+      if (t2 > tmax) { tmax = t2; pmax.set (p2); }
+      spans.push_back (std::pair<double, double> (std::min (t1, t2),
+                                                  std::max (t1, t2)));
+      npts.push_back (sizes[*it]);
+    }
+
+    // Counts the points once in overlapping parts
+    std::vector<int> order (spans.size ());
+    for (int k = 0; k < (int) (order.size ()); k++) order[k] = k;
+    for (int k = 1; k < (int) (order.size ()); k++)
+      for (int l = k; l > 0 && spans[order[l]].first < spans[order[l-1]].first;
+           l--) std::swap (order[l], order[l-1]);
+    double count = 0., covered = tmin;
+    bool started = false;
+    for (int k = 0; k < (int) (order.size ()); k++)
+    {
+      const std::pair<double, double> &sp = spans[order[k]];
+      double len = sp.second - sp.first;
+      double from = (started ? std::max (sp.first, covered) : sp.first);
+      if (sp.second > from)
+        count += (len == 0. ? npts[order[k]]
+                  : npts[order[k]] * (sp.second - from) / len);
+      else if (! started) count += npts[order[k]];
+      if (! started || sp.second > covered) covered = sp.second;
+      started = true;
+    }
+
+    ssegs.push_back (std::pair<Pt2i, Pt2i> (pmin, pmax));
+    ssizes.push_back ((int) (count + 0.5));
+    stiles.push_back (tiles[g]);
+    sopens.push_back (false);
+  }
+  segs.swap (ssegs);
+  sizes.swap (ssizes);
+  tiles.swap (stiles);
+  opens.swap (sopens);
+}
@@ -0,0 +1,184 @@
+#ifndef TILED_DETECTOR_H
+#define TILED_DETECTOR_H
+
+#include "bsdetector.h"
+
+
+/**
+ * @class TiledDetector tileddetector.h
+ * \brief Blurred segment detector for very large grey level images.
+ * The image is processed by square tiles extended with an overlapping halo.
+ * A gradient map is built for one tile at a time, so that the memory of the
+ *   gradient maps is bounded by the tile size, whatever the image size.
+ *   The grey level image itself is provided whole by the caller.
+ * Segments found in the halo of several tiles are kept only once, and
+ *   fragments of segments crossing the tile borders are stitched together.
+ */
+class TiledDetector
+{
+public:
+
+  /**
+   * \brief Creates a tiled detector (the whole image as a single tile).
+   */
+  TiledDetector ();
+
+  /**
+   * \brief Deletes the tiled detector.
+   */
+  ~TiledDetector ();
+
+  /**
+   * \brief Returns the blurred segment detector applied to each tile.
+   * Used to set the detection parameters.
+   */
+  inline BSDetector *getDetector () { return (&detector); }
+
+  /**
+   * \brief Returns the memory budget of a tile gradient map in megabytes (0 if illimited).
+   */
+  inline int getMemoryBudget () const { return memoryBudget; }
+
+  /**
+   * \brief Sets the memory budget of a tile gradient map.
+   * Tiles are not smaller than MIN_TILE_SIZE, so that small budgets may be exceeded.
+   * @param mbytes Memory budget in megabytes (0 for a single tile).
+   */
+  inline void setMemoryBudget (int mbytes) {
+    memoryBudget = (mbytes < 0 ? 0 : mbytes); }
+
+  /**
+   * \brief Returns the width of the halo added around each tile.
+   */
+  inline int getHalo () const { return halo; }
+
+  /**
+   * \brief Sets the width of the halo added around each tile.
+   * @param width Halo width in pixels.
+   */
+  inline void setHalo (int width) { if (width >= 0) halo = width; }
+
+  /**
+   * \brief Returns the side of the tiles (without halo) for given image size.
+   * @param width Image width.
+   * @param height Image height.
+   */
+  int tileSize (int width, int height) const;
+
+  /**
+   * \brief Detects all blurred segments in a grey level image.
+   * @param data Grey level image rows.
+   * @param width Image width.
+   * @param height Image height.
+   * @param stride Distance between the starts of two successive rows.
+   */
+  void detectAll (const unsigned char *data, int width, int height,
+                  int stride);
+
+  /**
+   * \brief Detects all blurred segments in given areas of a grey level image.
+   * Tiles that do not meet any area are skipped.
+   * @param data Grey level image rows.
+   * @param width Image width.
+   * @param height Image height.
+   * @param stride Distance between the starts of two successive rows.
+   * @param areas Areas as pairs of (top-left, bottom-right) points.
+   */
+  void detectAllInAreas (const unsigned char *data, int width, int height,
+                         int stride,
+                         const std::vector<std::pair<Pt2i, Pt2i> > &areas);
+
+  /**
+   * \brief Returns the end points of the detected segments.
+   */
+  inline const std::vector<std::pair<Pt2i, Pt2i> > &getSegments () const {
+    return (segs); }
+
+  /**
+   * \brief Returns the number of points of each detected segment.
+   */
+  inline const std::vector<int> &getSegmentSizes () const { return (sizes); }
+
+  /**
+   * \brief Returns the count of tiles processed in the last detection.
+   */
+  inline int countOfTiles () const { return (nbtiles); }
+
+  /**
+   * \brief Returns the count of trials skipped by the failure cache of the
+   *   detector in the last detection, over all the tiles.
+   */
+  inline int countOfSkippedTrials () const { return (nbskipped); }
+
+  /**
+   * \brief Returns the count of seeds rejected by the seed pre-filter
+   *   of the detector in the last detection, over all the tiles.
+   */
+  inline int countOfFilteredSeeds () const { return (nbfiltered); }
+
+  /**
+   * \brief Checks whether the detection was stopped by the time budget.
+   * The time budget of the tile detector is shared by all the tiles.
+   */
+  inline bool isTruncated () const { return truncated; }
+
+
+private:
+
+  /** Approximate memory cost of a gradient map pixel in a tile. */
+  static const int BYTES_PER_PIXEL;
+  /** Default width of the halo around each tile. */
+  static const int DEFAULT_HALO;
+  /** Minimal side of a tile (without halo). */
+  static const int MIN_TILE_SIZE;
+  /** Distance to a tile border under which a segment may be truncated. */
+  static const int BORDER_MARGIN;
+  /** Maximal distance between stitched fragment end and support line. */
+  static const int STITCH_DISTANCE;
+  /** Maximal gap between stitched fragments. */
+  static const int STITCH_GAP;
+  /** Maximal angle between stitched fragments (tangent in percent). */
+  static const int STITCH_SLOPE;
+
+  /** Detector applied to each tile. */
+  BSDetector detector;
+  /** Gradient map of the current tile. */
+  VMap *tileMap;
+  /** Memory budget of a tile gradient map in megabytes (0 if illimited). */
+  int memoryBudget;
+  /** Width of the halo around the tiles. */
+  int halo;
+  /** Count of tiles processed in the last detection. */
+  int nbtiles;
+  /** Count of trials skipped by the failure cache in the last detection. */
+  int nbskipped;
+  /** Count of seeds rejected by the seed pre-filter in the last detection. */
+  int nbfiltered;
+  /** Interruption status of a tile detection by the time budget. */
+  bool truncated;
+
+  /** End points of the detected segments. */
+  std::vector<std::pair<Pt2i, Pt2i> > segs;
+  /** Number of points of the detected segments. */
+  std::vector<int> sizes;
+  /** Tile of each detected fragment. */
+  std::vector<int> tiles;
+  /** Possible truncation of each detected fragment by a tile border. */
+  std::vector<bool> opens;
+
+
+  /**
+   * \brief Checks whether two fragments belong to a same straight segment.
+   * @param i Index of the first fragment.
+   * @param j Index of the second fragment.
+   */
+  bool areStitchable (int i, int j) const;
+
+  /**
+   * \brief Merges the fragments of segments crossing tile borders.
+   * @param ntx Count of tile columns.
+   * @param nty Count of tile rows.
+   */
+  void stitch (int ntx, int nty);
+};
+#endif
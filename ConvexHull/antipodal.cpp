@@ -87,6 +87,15 @@ int Antipodal::remainder (CHVertex *v) const
 }
 
 
+bool Antipodal::strictlyEncloses (CHVertex *v) const
+{
+  int rmp = remainder (v);
+  int rmv = remainder (vpt);
+  int rme = remainder (ept1);
+  return (rmp != rmv && rmp != rme && ((rmp < rmv) != (rmp < rme)));
+}
+
+
 bool Antipodal::edgeInFirstQuadrant () const
 {
   if (iy) return true;
@@ -89,6 +89,14 @@ public:
    */
   int remainder (CHVertex *v) const;
 
+  /**
+   * \brief Checks if given vertex lies strictly between the antipodal edge
+   *   and the parallel line through the antipodal vertex.
+   * Such a vertex leaves the antipodal pair unchanged.
+   * @param v Given vertex.
+   */
+  bool strictlyEncloses (CHVertex *v) const;
+
   /**
    * \brief Checks if the antipodal edge lies in first quadrant.
    * More formally, checks if sign(Ex) = sign(Ey).
@@ -3,9 +3,9 @@
 
 ConvexHull::ConvexHull (const Pt2i &lpt, const Pt2i &cpt, const Pt2i &rpt)
 {
-  CHVertex *cvert = new CHVertex (cpt);
-  leftVertex = new CHVertex (lpt);
-  rightVertex = new CHVertex (rpt);
+  CHVertex *cvert = newVertex (cpt);
+  leftVertex = newVertex (lpt);
+  rightVertex = newVertex (rpt);
   lastToLeft = false;
 
   if (lpt.toLeft (cpt, rpt))
@@ -31,10 +31,6 @@ ConvexHull::ConvexHull (const Pt2i &lpt, const Pt2i &cpt, const Pt2i &rpt)
   apv.setVertical ();
   apv.init (leftVertex, cvert, rightVertex);
 
-  gbg.push_back (leftVertex);
-  gbg.push_back (cvert);
-  gbg.push_back (rightVertex);
-
   old_left = leftVertex;
   old_right = rightVertex;
   old_aph_vertex = aph.vertex ();
@@ -48,7 +44,6 @@ ConvexHull::ConvexHull (const Pt2i &lpt, const Pt2i &cpt, const Pt2i &rpt)
 
 ConvexHull::~ConvexHull ()
 {
-  for (int i = 0; i < (int) (gbg.size ()); ++i) delete gbg [i];
 }
 
 
@@ -73,15 +68,15 @@ void ConvexHull::restore ()
   rightVertex = old_right;
   aph.setVertexAndEdge (old_aph_vertex, old_aph_edge_start, old_aph_edge_end);
   apv.setVertexAndEdge (old_apv_vertex, old_apv_edge_start, old_apv_edge_end);
+  vertices.pop_back ();
 }
 
 
 bool ConvexHull::addPoint (const Pt2i &pt, bool toleft)
 {
   if (inHull (pt, toleft)) return false;
-  CHVertex *vx = new CHVertex (pt);
+  CHVertex *vx = newVertex (pt);
   lastToLeft = toleft;
-  gbg.push_back (vx);
   preserve ();
   insert (vx, toleft);
   aph.update (vx);
@@ -92,11 +87,11 @@ bool ConvexHull::addPoint (const Pt2i &pt, bool toleft)
 
 bool ConvexHull::addPointDS (const Pt2i &pt, bool toleft)
 {
-  CHVertex *vx = new CHVertex (pt);
+  CHVertex *vx = newVertex (pt);
   lastToLeft = toleft;
-  gbg.push_back (vx);
   preserve ();
   insertDS (vx, toleft);
+  if (aph.strictlyEncloses (vx) && apv.strictlyEncloses (vx)) return true;
   aph.update (vx);
   apv.update (vx);
   return true;
@@ -107,7 +102,6 @@ bool ConvexHull::moveLastPoint (const Pt2i &pos)
 {
   restore ();
   if (inHull (pos, lastToLeft)) return false;
-  gbg.pop_back ();
   preserve ();
   addPoint (pos, lastToLeft);
   return true;
@@ -2,6 +2,7 @@
 #define CONVEXHULL
 
 #include "antipodal.h"
+#include <deque>
 
 
 /** 
@@ -30,6 +31,7 @@ public:
 
   /**
    * \brief Restores the convexhull features after a modification.
+   * The last inserted vertex is released.
    */
   void restore ();
 
@@ -45,6 +47,8 @@ public:
    * \brief Appends a new point at one side of the convex hull.
    * To be used with directional scans:
    *   in that case, added point can not be inside the hull.
+   * The antipodal pairs are not updated when the point lies strictly inside
+   *   both of them, as they would not change.
    * @param pt Reference to the point to add.
    * @param toleft Add the point at left side if true, right side otherwise.
    */
@@ -164,12 +168,22 @@ protected:
   /** Registered disconnected point to the right of previous polyline. */
   CHVertex *rdisconnect;
 
-  /** Collection of released vertices for clearance. */
-  std::vector<CHVertex*> gbg;
+  /** Storage of the vertices, released with the convex hull.
+   * Vertices are allocated by blocks and never move, so that the chaining
+   *   pointers remain valid while the hull grows. */
+  std::deque<CHVertex> vertices;
 
 
 private:
 
+  /**
+   * \brief Returns a new vertex at given position, taken in the storage.
+   * @param pt Position of the vertex.
+   */
+  inline CHVertex *newVertex (const Pt2i &pt) {
+    vertices.push_back (CHVertex (pt));
+    return (&(vertices.back ())); }
+
   /**
    * \brief Stores convex hull features before a modification.
    */
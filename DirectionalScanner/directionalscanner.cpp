@@ -3,8 +3,6 @@
 
 DirectionalScanner::~DirectionalScanner ()
 {
-  if (steps != NULL) delete steps;
-  steps = NULL;
 }
 
 
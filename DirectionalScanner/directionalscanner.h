@@ -87,7 +87,7 @@ protected:
   /** Size of the discrete line pattern. */
   int nbs;
 
-  /** Discrete line pattern. */
+  /** Discrete line pattern (shared, not owned by the scanner). */
   bool *steps;
   /** Pointer to the end of discrete line pattern. */
   bool *fs;
@@ -9,6 +9,52 @@
 #include "vhscannero8.h"
 
 
+const int ScannerProvider::MAX_CACHED_STEPS = 1 << 20;
+
+
+ScannerProvider::~ScannerProvider ()
+{
+  std::unordered_map<int64_t, std::pair<int, bool *> >::iterator it;
+  for (it = patterns.begin (); it != patterns.end (); it++)
+    delete [] it->second.second;
+}
+
+
+void ScannerProvider::releaseScanner (DirectionalScanner *ds)
+{
+  delete ds;
+  if (nbscanners > 0) nbscanners --;
+}
+
+
+bool *ScannerProvider::getSteps (int dx, int dy, int &nbs)
+{
+  // Each provided scanner holds a pattern until released
+  nbscanners ++;
+  int64_t key = ((int64_t) dx << 32) | (uint32_t) dy;
+  std::unordered_map<int64_t, std::pair<int, bool *> >::iterator it
+    = patterns.find (key);
+  if (it != patterns.end ())
+  {
+    nbs = it->second.first;
+    return (it->second.second);
+  }
+
+  // Flushes the cache when full and no provided scanner is still in use
+  if (cachedSteps > MAX_CACHED_STEPS && nbscanners == 1)
+  {
+    for (it = patterns.begin (); it != patterns.end (); it++)
+      delete [] it->second.second;
+    patterns.clear ();
+    cachedSteps = 0;
+  }
+  bool *steps = Pt2i (0, 0).stepsTo (Pt2i (dx, dy), &nbs);
+  patterns[key] = std::pair<int, bool *> (nbs, steps);
+  cachedSteps += nbs + 1;
+  return (steps);
+}
+
+
 DirectionalScanner *ScannerProvider::getScanner (Pt2i p1, Pt2i p2,
                                                  bool controlable)
 {
@@ -23,9 +69,9 @@ DirectionalScanner *ScannerProvider::getScanner (Pt2i p1, Pt2i p2,
     p2.set (tmp);
   }
 
-  // Computes the steps position array
+  // Gets the steps position array
   int nbs = 0;
-  bool *steps = p1.stepsTo (p2, &nbs);
+  bool *steps = getSteps (p2.x () - p1.x (), p2.y () - p1.y (), nbs);
 
   // Equation of the strip support lines : ax + by = c
   int a = p2.x () - p1.x ();
@@ -116,8 +162,7 @@ DirectionalScanner *ScannerProvider::getScanner (Pt2i centre, Vr2i normal,
 {
   // Gets the steps position array
   int nbs = 0;
-  bool *steps = centre.stepsTo (Pt2i (centre.x () + normal.x (),
-                                      centre.y () + normal.y ()), &nbs);
+  bool *steps = getSteps (normal.x (), normal.y (), nbs);
 
   // Orients rightwards
   int a = normal.x ();
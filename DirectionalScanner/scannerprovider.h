@@ -1,6 +1,8 @@
 #ifndef SCANNER_PROVIDER_H
 #define SCANNER_PROVIDER_H
 
+#include <unordered_map>
+#include <inttypes.h>
 #include "directionalscanner.h"
 
 
@@ -9,6 +11,10 @@
  * \brief Directional scanner provider.
  * Provides ad-hoc directional scanners in the relevant octant
  *   and according to static or dynamical control.
+ * Discrete line patterns are cached by direction and shared by the
+ *   provided scanners, which must be released through releaseScanner
+ *   before the provider is deleted.
+ * The cache is only flushed when no provided scanner is in use.
  */
 class ScannerProvider
 {
@@ -18,7 +24,13 @@ public:
    * \brief Builds a directional scanner provider.
    */
   ScannerProvider () : isOrtho (false), last_scan_reversed (false),
-                       xmin (0), ymin (0), xmax (100), ymax (100) { }
+                       xmin (0), ymin (0), xmax (100), ymax (100),
+                       cachedSteps (0), nbscanners (0) { }
+
+  /**
+   * \brief Deletes the directional scanner provider and its cached patterns.
+   */
+  ~ScannerProvider ();
   
   /**
    * \brief Sets the scanned area size.
@@ -61,6 +73,14 @@ public:
   DirectionalScanner *getScanner (Pt2i centre, Vr2i normal,
                                   int length, bool controlable = false);
 
+  /**
+   * \brief Deletes a scanner provided by this provider.
+   * Scanners deleted otherwise are still counted as in use, which only
+   *   prevents the cache flushes.
+   * @param ds Provided scanner.
+   */
+  void releaseScanner (DirectionalScanner *ds);
+
   /**
    * \brief Returns whether the currently used scan end points were permutated.
    */
@@ -89,5 +109,28 @@ private:
   /** Scan area highest y coordinate. */
   int ymax;
 
+  /** Maximal cumulated size of the cached patterns. */
+  static const int MAX_CACHED_STEPS;
+
+  /** Cached discrete line patterns, indexed by direction vector. */
+  std::unordered_map<int64_t, std::pair<int, bool *> > patterns;
+  /** Cumulated size of the cached patterns. */
+  int cachedSteps;
+  /** Count of provided scanners not yet released. */
+  int nbscanners;
+
+
+  /**
+   * \brief Returns the discrete line pattern of given direction.
+   * The pattern is computed on first request, then kept in cache.
+   * The cache is flushed when full, provided that no other scanner is in
+   *   use, as it would invalidate their patterns.
+   * Counts the calling scanner as in use.
+   * @param dx Direction vector X coordinate.
+   * @param dy Direction vector Y coordinate.
+   * @param nbs Returned size of the pattern.
+   */
+  bool *getSteps (int dx, int dy, int &nbs);
+
 };
 #endif
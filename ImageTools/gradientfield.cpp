@@ -0,0 +1,426 @@
+#include "gradientfield.h"
+
+
+const int GradientField::TYPE_UNKNOWN = -1;
+const int GradientField::TYPE_SOBEL_3X3 = 0;
+const int GradientField::TYPE_SOBEL_5X5 = 1;
+
+
+
+GradientField::GradientField (int width, int height,
+                              unsigned char *data, int type)
+{
+  this->width = width;
+  this->height = height;
+  this->gtype = type;
+  init ();
+  if (type == TYPE_SOBEL_5X5) buildSobel5x5Map (data);
+  else if (type == TYPE_SOBEL_3X3) buildSobel3x3Map (data);
+  else for (int i = 0; i < width * height; i++) setGradient (i, 0, 0);
+}
+
+
+GradientField::GradientField (int width, int height, int *data, int type)
+{
+  this->width = width;
+  this->height = height;
+  this->gtype = type;
+  init ();
+  if (type == TYPE_SOBEL_5X5) buildSobel5x5Map (data);
+  else if (type == TYPE_SOBEL_3X3) buildSobel3x3Map (data);
+  else for (int i = 0; i < width * height; i++) setGradient (i, 0, 0);
+}
+
+
+GradientField::GradientField (int width, int height, int **data, int type)
+{
+  this->width = width;
+  this->height = height;
+  this->gtype = type;
+  init ();
+  if (type == TYPE_SOBEL_5X5) buildSobel5x5Map (data);
+  else if (type == TYPE_SOBEL_3X3) buildSobel3x3Map (data);
+  else for (int i = 0; i < width * height; i++) setGradient (i, 0, 0);
+}
+
+
+GradientField::GradientField (RowSource &source, int type,
+                              unsigned char *data)
+{
+  this->width = source.getWidth ();
+  this->height = source.getHeight ();
+  this->gtype = type;
+  init ();
+  if (type == TYPE_SOBEL_5X5) buildSobel5x5Map (source, data);
+  else buildSobel3x3Map (source, data);
+}
+
+
+GradientField::GradientField (int width, int height, Vr2i *map)
+{
+  this->width = width;
+  this->height = height;
+  this->gtype = TYPE_UNKNOWN;
+  init ();
+  for (int i = 0; i < width * height; i++)
+    setGradient (i, map[i].x (), map[i].y ());
+  delete [] map;
+}
+
+
+GradientField::~GradientField ()
+{
+  delete [] gx;
+  delete [] gy;
+  delete [] gmag;
+}
+
+
+void GradientField::init ()
+{
+  gx = new int16_t[width * height];
+  gy = new int16_t[width * height];
+  gmag = new uint16_t[width * height];
+}
+
+
+void GradientField::buildSobel3x3Map (unsigned char *data)
+{
+  int k = 0;
+
+  for (int j = 0; j < width; j++) setGradient (k++, 0, 0);
+  for (int i = 1; i < height - 1; i++)
+  {
+    setGradient (k++, 0, 0);
+    for (int j = 1; j < width - 1; j++)
+    {
+      setGradient (k++, data[(i - 1) * width + j + 1]
+                        + 2 * data[i * width + j + 1]
+                        + data[(i + 1) * width + j + 1]
+                        - data[(i - 1) * width + j - 1]
+                        - 2 * data[i * width + j - 1]
+                        - data[(i + 1) * width + j - 1],
+                        data[(i + 1) * width + j - 1]
+                        + 2 * data[(i + 1) * width + j]
+                        + data[(i + 1) * width + j + 1]
+                        - data[(i - 1) * width + j - 1]
+                        - 2 * data[(i - 1) * width + j]
+                        - data[(i - 1) * width + j + 1]);
+    }
+    setGradient (k++, 0, 0);
+  }
+  for (int j = 0; j < width; j++) setGradient (k++, 0, 0);
+}
+
+
+void GradientField::buildSobel3x3Map (int *data)
+{
+  int k = 0;
+
+  for (int j = 0; j < width; j++) setGradient (k++, 0, 0);
+  for (int i = 1; i < height - 1; i++)
+  {
+    setGradient (k++, 0, 0);
+    for (int j = 1; j < width - 1; j++)
+    {
+      setGradient (k++, data[(i - 1) * width + j + 1]
+                        + 2 * data[i * width + j + 1]
+                        + data[(i + 1) * width + j + 1]
+                        - data[(i - 1) * width + j - 1]
+                        - 2 * data[i * width + j - 1]
+                        - data[(i + 1) * width + j - 1],
+                        data[(i + 1) * width + j - 1]
+                        + 2 * data[(i + 1) * width + j]
+                        + data[(i + 1) * width + j + 1]
+                        - data[(i - 1) * width + j - 1]
+                        - 2 * data[(i - 1) * width + j]
+                        - data[(i - 1) * width + j + 1]);
+    }
+    setGradient (k++, 0, 0);
+  }
+  for (int j = 0; j < width; j++) setGradient (k++, 0, 0);
+}
+
+
+void GradientField::buildSobel3x3Map (int **data)
+{
+  int k = 0;
+
+  for (int j = 0; j < width; j++) setGradient (k++, 0, 0);
+  for (int i = 1; i < height - 1; i++)
+  {
+    setGradient (k++, 0, 0);
+    for (int j = 1; j < width - 1; j++)
+    {
+      setGradient (k++, data[i-1][j+1] + 2 * data[i][j+1] + data[i+1][j+1]
+                        - data[i-1][j-1] - 2 * data[i][j-1] - data[i+1][j-1],
+                        data[i+1][j-1] + 2 * data[i+1][j] + data[i+1][j+1]
+                        - data[i-1][j-1] - 2 * data[i-1][j] - data[i-1][j+1]);
+    }
+    setGradient (k++, 0, 0);
+  }
+  for (int j = 0; j < width; j++) setGradient (k++, 0, 0);
+}
+
+
+void GradientField::buildSobel5x5Map (unsigned char *data)
+{
+  int k = 0;
+
+  for (int j = 0; j < 2 * width; j++) setGradient (k++, 0, 0);
+  for (int i = 2; i < height - 2; i++)
+  {
+    setGradient (k++, 0, 0);
+    setGradient (k++, 0, 0);
+    for (int j = 2; j < width - 2; j++)
+    {
+      setGradient (k++, 5 * data[(i - 2) * width + j + 2]
+                          + 8 * data[(i - 1) * width + j + 2]
+                          + 10 * data[i * width + j + 2]
+                          + 8 * data[(i + 1) * width + j + 2]
+                          + 5 * data[(i + 2) * width + j + 2]
+                        + 4 * data[(i - 2) * width + j + 1]
+                          + 10 * data[(i - 1) * width + j + 1]
+                          + 20 * data[i * width + j + 1]
+                          + 10 * data[(i + 1) * width + j + 1]
+                          + 4 * data[(i + 2) * width + j + 1]
+                        - 4 * data[(i - 2) * width + j - 1]
+                          - 10 * data[(i - 1) * width + j - 1]
+                          - 20 * data[i * width + j - 1]
+                          - 10 * data[(i + 1) * width + j - 1]
+                          - 4 * data[(i + 2) * width + j - 1] 
+                        - 5 * data[(i - 2) * width + j - 2]
+                          - 8 * data[(i - 1) * width + j - 2]
+                          - 10 * data[i * width + j - 2]
+                          - 8 * data[(i + 1) * width + j - 2]
+                          - 5 * data[(i + 2) * width + j - 2],
+                        5 * data[(i + 2) * width + j - 2]
+                          + 8 * data[(i + 2) * width + j - 1]
+                          + 10 * data[(i + 2) * width + j]
+                          + 8 * data[(i + 2) * width + j + 1]
+                          + 5 * data[(i + 2) * width + j + 2]
+                        + 4 * data[(i + 1) * width + j - 2]
+                          + 10 * data[(i + 1) * width + j - 1]
+                          + 20 * data[(i + 1) * width + j]
+                          + 10 * data[(i + 1) * width + j + 1]
+                          + 4 * data[(i + 1) * width + j + 2]
+                        - 4 * data[(i - 1) * width + j - 2]
+                          - 10 * data[(i - 1) * width + j - 1]
+                          - 20 * data[(i - 1) * width + j]
+                          - 10 * data[(i - 1) * width + j + 1]
+                          - 4 * data[(i - 1) * width + j + 2]
+                        - 5 * data[(i - 2) * width + j - 2]
+                          - 8 * data[(i - 2) * width + j - 1]
+                          - 10 * data[(i - 2) * width + j]
+                          - 8 * data[(i - 2) * width + j + 1]
+                          - 5 * data[(i - 2) * width + j + 2]);
+    }
+    setGradient (k++, 0, 0);
+    setGradient (k++, 0, 0);
+  }
+  for (int j = 0; j < 2 * width; j++) setGradient (k++, 0, 0);
+}
+
+
+void GradientField::buildSobel5x5Map (int *data)
+{
+  int k = 0;
+
+  for (int j = 0; j < 2 * width; j++) setGradient (k++, 0, 0);
+  for (int i = 2; i < height - 2; i++)
+  {
+    setGradient (k++, 0, 0);
+    setGradient (k++, 0, 0);
+    for (int j = 2; j < width - 2; j++)
+    {
+      setGradient (k++, 5 * data[(i - 2) * width + j + 2]
+                          + 8 * data[(i - 1) * width + j + 2]
+                          + 10 * data[i * width + j + 2]
+                          + 8 * data[(i + 1) * width + j + 2]
+                          + 5 * data[(i + 2) * width + j + 2]
+                        + 4 * data[(i - 2) * width + j + 1]
+                          + 10 * data[(i - 1) * width + j + 1]
+                          + 20 * data[i * width + j + 1]
+                          + 10 * data[(i + 1) * width + j + 1]
+                          + 4 * data[(i + 2) * width + j + 1]
+                        - 4 * data[(i - 2) * width + j - 1]
+                          - 10 * data[(i - 1) * width + j - 1]
+                          - 20 * data[i * width + j - 1]
+                          - 10 * data[(i + 1) * width + j - 1]
+                          - 4 * data[(i + 2) * width + j - 1] 
+                        - 5 * data[(i - 2) * width + j - 2]
+                          - 8 * data[(i - 1) * width + j - 2]
+                          - 10 * data[i * width + j - 2]
+                          - 8 * data[(i + 1) * width + j - 2]
+                          - 5 * data[(i + 2) * width + j - 2],
+                        5 * data[(i + 2) * width + j - 2]
+                          + 8 * data[(i + 2) * width + j - 1]
+                          + 10 * data[(i + 2) * width + j]
+                          + 8 * data[(i + 2) * width + j + 1]
+                          + 5 * data[(i + 2) * width + j + 2]
+                        + 4 * data[(i + 1) * width + j - 2]
+                          + 10 * data[(i + 1) * width + j - 1]
+                          + 20 * data[(i + 1) * width + j]
+                          + 10 * data[(i + 1) * width + j + 1]
+                          + 4 * data[(i + 1) * width + j + 2]
+                        - 4 * data[(i - 1) * width + j - 2]
+                          - 10 * data[(i - 1) * width + j - 1]
+                          - 20 * data[(i - 1) * width + j]
+                          - 10 * data[(i - 1) * width + j + 1]
+                          - 4 * data[(i - 1) * width + j + 2]
+                        - 5 * data[(i - 2) * width + j - 2]
+                          - 8 * data[(i - 2) * width + j - 1]
+                          - 10 * data[(i - 2) * width + j]
+                          - 8 * data[(i - 2) * width + j + 1]
+                          - 5 * data[(i - 2) * width + j + 2]);
+    }
+    setGradient (k++, 0, 0);
+    setGradient (k++, 0, 0);
+  }
+  for (int j = 0; j < 2 * width; j++) setGradient (k++, 0, 0);
+}
+
+
+void GradientField::buildSobel5x5Map (int **data)
+{
+  int k = 0;
+
+  for (int j = 0; j < 2 * width; j++) setGradient (k++, 0, 0);
+  for (int i = 2; i < height - 2; i++)
+  {
+    setGradient (k++, 0, 0);
+    setGradient (k++, 0, 0);
+    for (int j = 2; j < width - 2; j++)
+    {
+      setGradient (k++,
+        5 * data[i-2][j+2] + 8 * data[i-1][j+2] + 10 * data[i][j+2]
+                           + 8 * data[i+1][j+2] + 5 * data[i+2][j+2]
+        + 4 * data[i-2][j+1] + 10 * data[i-1][j+1] + 20 * data[i][j+1]
+                           + 10 * data[i+1][j+1] + 4 * data[i+2][j+1]
+        - 4 * data[i-2][j-1] - 10 * data[i-1][j-1] - 20 * data[i][j-1]
+                           - 10 * data[i+1][j-1] - 4 * data[i+2][j-1]
+        - 5 * data[i-2][j-2] - 8 * data[i-1][j-2] - 10 * data[i][j-2]
+                           - 8 * data[i+1][j-2] - 5 * data[i+2][j-2],
+        5 * data[i+2][j-2] + 8 * data[i+2][j-1] + 10 * data[i+2][j]
+                           + 8 * data[i+2][j+1] + 5 * data[i+2][j+2]
+        + 4 * data[i+1][j-2] + 10 * data[i+1][j-1] + 20 * data[i+1][j]
+                           + 10 * data[i+1][j+1] + 4 * data[i+1][j+2]
+        - 4 * data[i-1][j-2] - 10 * data[i-1][j-1] - 20 * data[i-1][j]
+                           - 10 * data[i-1][j+1] - 4 * data[i-1][j+2]
+        - 5 * data[i-2][j-2] - 8 * data[i-2][j-1] - 10 * data[i-2][j]
+                           - 8 * data[i-2][j+1] - 5 * data[i-2][j+2]);
+    }
+    setGradient (k++, 0, 0);
+    setGradient (k++, 0, 0);
+  }
+  for (int j = 0; j < 2 * width; j++) setGradient (k++, 0, 0);
+}
+
+
+void GradientField::buildSobel3x3Map (RowSource &source, unsigned char *data)
+{
+  for (int i = 0; i < width * height; i++) setGradient (i, 0, 0);
+  unsigned char *ring = new unsigned char[3 * width];
+  bool reading = true;
+
+  for (int k = 0; k < height; k++)
+  {
+    // Reads row k (missing rows are set to 0)
+    unsigned char *rk = ring + (k % 3) * width;
+    if (reading) reading = source.nextRow (rk);
+    if (! reading) for (int j = 0; j < width; j++) rk[j] = 0;
+    if (data != NULL)
+      for (int j = 0; j < width; j++) data[k * width + j] = rk[j];
+
+    // Computes gradient row k - 1 from rows k - 2 to k
+    if (k < 2) continue;
+    const unsigned char *r0 = ring + ((k - 2) % 3) * width;
+    const unsigned char *r1 = ring + ((k - 1) % 3) * width;
+    const unsigned char *r2 = rk;
+    int g = (k - 1) * width + 1;
+    for (int j = 1; j < width - 1; j++)
+    {
+      setGradient (g++, r0[j + 1]
+                        + 2 * r1[j + 1]
+                        + r2[j + 1]
+                        - r0[j - 1]
+                        - 2 * r1[j - 1]
+                        - r2[j - 1],
+                        r2[j - 1]
+                        + 2 * r2[j]
+                        + r2[j + 1]
+                        - r0[j - 1]
+                        - 2 * r0[j]
+                        - r0[j + 1]);
+    }
+  }
+  delete [] ring;
+}
+
+
+void GradientField::buildSobel5x5Map (RowSource &source, unsigned char *data)
+{
+  for (int i = 0; i < width * height; i++) setGradient (i, 0, 0);
+  unsigned char *ring = new unsigned char[5 * width];
+  const unsigned char *r[5];
+  bool reading = true;
+
+  for (int k = 0; k < height; k++)
+  {
+    // Reads row k (missing rows are set to 0)
+    unsigned char *rk = ring + (k % 5) * width;
+    if (reading) reading = source.nextRow (rk);
+    if (! reading) for (int j = 0; j < width; j++) rk[j] = 0;
+    if (data != NULL)
+      for (int j = 0; j < width; j++) data[k * width + j] = rk[j];
+
+    // Computes gradient row k - 2 from rows k - 4 to k
+    if (k < 4) continue;
+    for (int l = 0; l < 5; l++) r[l] = ring + ((k - 4 + l) % 5) * width;
+    int g = (k - 2) * width + 2;
+    for (int j = 2; j < width - 2; j++)
+    {
+      setGradient (g++, 5 * r[0][j + 2]
+                          + 8 * r[1][j + 2]
+                          + 10 * r[2][j + 2]
+                          + 8 * r[3][j + 2]
+                          + 5 * r[4][j + 2]
+                        + 4 * r[0][j + 1]
+                          + 10 * r[1][j + 1]
+                          + 20 * r[2][j + 1]
+                          + 10 * r[3][j + 1]
+                          + 4 * r[4][j + 1]
+                        - 4 * r[0][j - 1]
+                          - 10 * r[1][j - 1]
+                          - 20 * r[2][j - 1]
+                          - 10 * r[3][j - 1]
+                          - 4 * r[4][j - 1]
+                        - 5 * r[0][j - 2]
+                          - 8 * r[1][j - 2]
+                          - 10 * r[2][j - 2]
+                          - 8 * r[3][j - 2]
+                          - 5 * r[4][j - 2],
+                        5 * r[4][j - 2]
+                          + 8 * r[4][j - 1]
+                          + 10 * r[4][j]
+                          + 8 * r[4][j + 1]
+                          + 5 * r[4][j + 2]
+                        + 4 * r[3][j - 2]
+                          + 10 * r[3][j - 1]
+                          + 20 * r[3][j]
+                          + 10 * r[3][j + 1]
+                          + 4 * r[3][j + 2]
+                        - 4 * r[1][j - 2]
+                          - 10 * r[1][j - 1]
+                          - 20 * r[1][j]
+                          - 10 * r[1][j + 1]
+                          - 4 * r[1][j + 2]
+                        - 5 * r[0][j - 2]
+                          - 8 * r[0][j - 1]
+                          - 10 * r[0][j]
+                          - 8 * r[0][j + 1]
+                          - 5 * r[0][j + 2]);
+    }
+  }
+  delete [] ring;
+}
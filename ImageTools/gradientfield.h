@@ -0,0 +1,211 @@
+#ifndef GRADIENT_FIELD_H
+#define GRADIENT_FIELD_H
+
+#include <cmath>
+#include <inttypes.h>
+#include "pt2i.h"
+#include "rowsource.h"
+
+
+/** 
+ * @class GradientField gradientfield.h
+ * \brief Immutable gradient field of an image.
+ * Vector components and magnitudes are stored in separate 16 bit planes
+ *   (6 bytes per pixel), which is enough for Sobel gradients of 8 bit images.
+ *   Larger values are saturated.
+ * The field is never modified once built, so that it can be shared by
+ *   several vector maps, possibly used in parallel threads.
+ */
+class GradientField
+{
+public:
+
+  /** Gradient extraction method : Undeterminated. */
+  static const int TYPE_UNKNOWN;
+  /** Gradient extraction method : Sobel with 3x3 kernel. */
+  static const int TYPE_SOBEL_3X3;
+  /** Gradient extraction method : Sobel with 5x5 kernel. */
+  static const int TYPE_SOBEL_5X5;
+
+
+  /** 
+   * \brief Creates a gradient field from scalar data.
+   * @param width Map width.
+   * @param height Map height.
+   * @param data Scalar data array.
+   * @param type Gradient extraction method (default is Sobel with 3x3 kernel).
+   */
+  GradientField (int width, int height, unsigned char *data, int type = 0);
+
+  /** 
+   * \brief Creates a gradient field from scalar data.
+   * @param width Map width.
+   * @param height Map height.
+   * @param data Scalar data array.
+   * @param type Gradient extraction method (default is Sobel with 3x3 kernel).
+   */
+  GradientField (int width, int height, int *data, int type = 0);
+
+  /** 
+   * \brief Creates a gradient field from scalar data.
+   * @param width Map width.
+   * @param height Map height.
+   * @param data Scalar data bi-dimensional array.
+   */
+  GradientField (int width, int height, int **data, int type = 0);
+
+  /** 
+   * \brief Creates a gradient field from grey level rows.
+   * Rows are read once, only the rows covered by the gradient kernel being
+   *   kept in a ring buffer.
+   * @param source Grey level row source.
+   * @param type Gradient extraction method (default is Sobel with 3x3 kernel).
+   * @param data Output scalar data array, filled with the rows if not null.
+   */
+  GradientField (RowSource &source, int type = 0, unsigned char *data = NULL);
+
+  /** 
+   * \brief Creates a gradient field from given vector map.
+   * The vector map is copied in the compact planes, then deleted.
+   * @param width Map width.
+   * @param height Map height.
+   * @param map Vector map.
+   */
+  GradientField (int width, int height, Vr2i *map);
+
+  /** 
+   * \brief Deletes the gradient field.
+   */
+  ~GradientField ();
+
+  /** 
+   * \brief Returns the field width.
+   */
+  inline int getWidth () const { return width; }
+
+  /** 
+   * \brief Returns the field height.
+   */
+  inline int getHeight () const { return height; }
+
+  /** 
+   * \brief Returns the gradient extraction method.
+   */
+  inline int getType () const { return gtype; }
+
+  /**
+   * \brief Returns the vector X components plane.
+   */
+  inline const int16_t *getXPlane () const { return gx; }
+
+  /**
+   * \brief Returns the vector Y components plane.
+   */
+  inline const int16_t *getYPlane () const { return gy; }
+
+  /**
+   * \brief Returns the vector magnitudes plane.
+   */
+  inline const uint16_t *getMagnitudePlane () const { return gmag; }
+
+
+private:
+
+  /** Image width. */
+  int width;
+  /** Image height. */
+  int height;
+  /** Gradient type. */
+  int gtype;
+  /** Vector map X components. */
+  int16_t *gx;
+  /** Vector map Y components. */
+  int16_t *gy;
+  /** Magnitude map (norm). */
+  uint16_t *gmag;
+
+
+  /** 
+   * \brief Allocates the planes of the gradient field.
+   */
+  void init ();
+
+  /**
+   * \brief Sets the vector at given index, saturated to 16 bits.
+   * @param k Index of the pixel.
+   * @param vx Vector X component.
+   * @param vy Vector Y component.
+   */
+  inline void setGradient (int k, int vx, int vy)
+  {
+    if (vx > INT16_MAX) vx = INT16_MAX;
+    else if (vx < - INT16_MAX) vx = - INT16_MAX;
+    if (vy > INT16_MAX) vy = INT16_MAX;
+    else if (vy < - INT16_MAX) vy = - INT16_MAX;
+    gx[k] = (int16_t) vx;
+    gy[k] = (int16_t) vy;
+    gmag[k] = (uint16_t) sqrt ((double) (vx * vx + vy * vy));
+  }
+
+  /** 
+   * \brief Builds the gradient field from provided data.
+   * Uses a Sobel 3x3 kernel by default.
+   * @param data Initial scalar data.
+   */
+  void buildSobel3x3Map (unsigned char *data);
+
+  /** 
+   * \brief Builds the gradient field from provided data.
+   * Uses a Sobel 3x3 kernel by default.
+   * @param data Initial scalar data.
+   */
+  void buildSobel3x3Map (int *data);
+
+  /** 
+   * \brief Builds the gradient field from provided data.
+   * Uses a Sobel 3x3 kernel by default.
+   * @param data Initial bi-dimensional scalar data.
+   */
+  void buildSobel3x3Map (int **data);
+
+  /** 
+   * \brief Builds the gradient field from provided data.
+   * Uses a Sobel 5x5 kernel.
+   * @param data Initial scalar data.
+   */
+  void buildSobel5x5Map (unsigned char *data);
+
+  /** 
+   * \brief Builds the gradient field from provided data.
+   * Uses a Sobel 5x5 kernel.
+   * @param data Initial scalar data.
+   */
+  void buildSobel5x5Map (int *data);
+
+  /** 
+   * \brief Builds the gradient field from provided data.
+   * Uses a Sobel 5x5 kernel.
+   * @param data Initial bi-dimensional scalar data.
+   */
+  void buildSobel5x5Map (int **data);
+
+  /** 
+   * \brief Builds the gradient field from a row source.
+   * Uses a Sobel 3x3 kernel on a ring buffer of 3 rows.
+   * The gradient magnitude map is filled in the same pass.
+   * @param source Grey level row source.
+   * @param data Output scalar data array, filled with the rows if not null.
+   */
+  void buildSobel3x3Map (RowSource &source, unsigned char *data);
+
+  /** 
+   * \brief Builds the gradient field from a row source.
+   * Uses a Sobel 5x5 kernel on a ring buffer of 5 rows.
+   * The gradient magnitude map is filled in the same pass.
+   * @param source Grey level row source.
+   * @param data Output scalar data array, filled with the rows if not null.
+   */
+  void buildSobel5x5Map (RowSource &source, unsigned char *data);
+
+};
+#endif
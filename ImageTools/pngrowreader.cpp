@@ -0,0 +1,119 @@
+#include "pngrowreader.h"
+#include <cstring>
+
+
+PngRowReader::PngRowReader ()
+{
+  fp = NULL;
+  png = NULL;
+  info = NULL;
+  width = 0;
+  height = 0;
+  colour = false;
+  rowIndex = 0;
+  image = NULL;
+}
+
+
+PngRowReader::~PngRowReader ()
+{
+  close ();
+}
+
+
+bool PngRowReader::open (const std::string &filename, bool colour)
+{
+  close ();
+  this->colour = colour;
+  fp = fopen (filename.c_str (), "rb");
+  if (fp == NULL) return false;
+  unsigned char sig[8];
+  if (fread (sig, 1, 8, fp) != 8 || png_sig_cmp (sig, 0, 8))
+  {
+    close ();
+    return false;
+  }
+  png = png_create_read_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png != NULL) info = png_create_info_struct (png);
+  if (info == NULL)
+  {
+    close ();
+    return false;
+  }
+  if (setjmp (png_jmpbuf (png)))
+  {
+    close ();
+    return false;
+  }
+  png_init_io (png, fp);
+  png_set_sig_bytes (png, 8);
+  png_read_info (png, info);
+
+  // Conversion to 8-bit grey levels or RGB, as done by usual image loaders
+  int ctype = png_get_color_type (png, info);
+  png_set_expand (png);
+  png_set_strip_16 (png);
+  png_set_strip_alpha (png);
+  if (colour)
+  {
+    if ((ctype & PNG_COLOR_MASK_COLOR) == 0) png_set_gray_to_rgb (png);
+  }
+  else if (ctype & PNG_COLOR_MASK_COLOR)
+    png_set_rgb_to_gray_fixed (png, 1, 29900, 58700);
+  int passes = png_set_interlace_handling (png);
+  png_read_update_info (png, info);
+  width = (int) png_get_image_width (png, info);
+  height = (int) png_get_image_height (png, info);
+  rowIndex = 0;
+
+  if (passes > 1)
+  {
+    int rowbytes = width * getChannels ();
+    image = new unsigned char[rowbytes * height];
+    png_bytep *rows = new png_bytep[height];
+    for (int j = 0; j < height; j++) rows[j] = image + j * rowbytes;
+    if (setjmp (png_jmpbuf (png)))
+    {
+      delete [] rows;
+      close ();
+      return false;
+    }
+    png_read_image (png, rows);
+    delete [] rows;
+  }
+  return true;
+}
+
+
+void PngRowReader::close ()
+{
+  if (png != NULL) png_destroy_read_struct (&png, info ? &info : NULL, NULL);
+  png = NULL;
+  info = NULL;
+  if (fp != NULL) fclose (fp);
+  fp = NULL;
+  if (image != NULL) delete [] image;
+  image = NULL;
+}
+
+
+bool PngRowReader::nextRow (unsigned char *row)
+{
+  if (png == NULL || rowIndex >= height) return false;
+  if (image != NULL)
+  {
+    int rowbytes = width * getChannels ();
+    memcpy (row, image + rowIndex * rowbytes, rowbytes);
+  }
+  else
+  {
+    if (setjmp (png_jmpbuf (png)))
+    {
+      close ();
+      return false;
+    }
+    png_read_row (png, row, NULL);
+  }
+  rowIndex ++;
+  return true;
+}
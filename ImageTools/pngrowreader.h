@@ -0,0 +1,85 @@
+#ifndef PNG_ROW_READER_H
+#define PNG_ROW_READER_H
+
+#include "rowsource.h"
+#include <png.h>
+#include <cstdio>
+#include <string>
+
+
+/**
+ * @class PngRowReader pngrowreader.h
+ * \brief Row by row reader of PNG image files.
+ * Rows are converted on the fly to 8-bit grey levels or to 8-bit RGB.
+ * Interlaced files can not be streamed and are decoded at once.
+ */
+class PngRowReader : public RowSource
+{
+public:
+
+  /**
+   * \brief Creates a PNG row reader.
+   */
+  PngRowReader ();
+
+  /**
+   * \brief Deletes the PNG row reader.
+   */
+  ~PngRowReader ();
+
+  /**
+   * \brief Opens a PNG file and reads its header.
+   * Returns false if the file is not a readable PNG image.
+   * @param filename Name of the PNG file.
+   * @param colour Provides RGB rows if true, grey level rows otherwise.
+   */
+  bool open (const std::string &filename, bool colour = false);
+
+  /**
+   * \brief Closes the file.
+   */
+  void close ();
+
+  /**
+   * \brief Returns the row width in pixels.
+   */
+  inline int getWidth () const { return width; }
+
+  /**
+   * \brief Returns the count of rows.
+   */
+  inline int getHeight () const { return height; }
+
+  /**
+   * \brief Returns the count of bytes per pixel (3 for RGB, 1 for grey).
+   */
+  inline int getChannels () const { return (colour ? 3 : 1); }
+
+  /**
+   * \brief Decodes the next row into given buffer.
+   * Returns false if no more row is available or on decoding error.
+   * @param row Output buffer of getWidth () * getChannels () bytes.
+   */
+  bool nextRow (unsigned char *row);
+
+
+private:
+
+  /** Opened file. */
+  FILE *fp;
+  /** Decoder structure. */
+  png_structp png;
+  /** Image information. */
+  png_infop info;
+  /** Image width. */
+  int width;
+  /** Image height. */
+  int height;
+  /** RGB or grey level rows. */
+  bool colour;
+  /** Index of the next row. */
+  int rowIndex;
+  /** Fully decoded image (only for interlaced files). */
+  unsigned char *image;
+};
+#endif
@@ -0,0 +1,85 @@
+#include "pngrowwriter.h"
+
+
+PngRowWriter::PngRowWriter ()
+{
+  fp = NULL;
+  png = NULL;
+  info = NULL;
+  height = 0;
+  rowIndex = 0;
+}
+
+
+PngRowWriter::~PngRowWriter ()
+{
+  release ();
+}
+
+
+bool PngRowWriter::open (const std::string &filename,
+                         int width, int height, int channels)
+{
+  release ();
+  fp = fopen (filename.c_str (), "wb");
+  if (fp == NULL) return false;
+  png = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png != NULL) info = png_create_info_struct (png);
+  if (info == NULL)
+  {
+    release ();
+    return false;
+  }
+  if (setjmp (png_jmpbuf (png)))
+  {
+    release ();
+    return false;
+  }
+  png_init_io (png, fp);
+  png_set_compression_level (png, 1);
+  png_set_IHDR (png, info, width, height, 8,
+                (channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY),
+                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                PNG_FILTER_TYPE_DEFAULT);
+  png_write_info (png, info);
+  this->height = height;
+  rowIndex = 0;
+  return true;
+}
+
+
+bool PngRowWriter::writeRow (const unsigned char *row)
+{
+  if (png == NULL || rowIndex >= height) return false;
+  if (setjmp (png_jmpbuf (png)))
+  {
+    release ();
+    return false;
+  }
+  png_write_row (png, (png_const_bytep) row);
+  rowIndex ++;
+  return true;
+}
+
+
+bool PngRowWriter::close ()
+{
+  bool ok = (png != NULL && rowIndex == height);
+  if (ok)
+  {
+    if (setjmp (png_jmpbuf (png))) ok = false;
+    else png_write_end (png, NULL);
+  }
+  release ();
+  return ok;
+}
+
+
+void PngRowWriter::release ()
+{
+  if (png != NULL) png_destroy_write_struct (&png, info ? &info : NULL);
+  png = NULL;
+  info = NULL;
+  if (fp != NULL) fclose (fp);
+  fp = NULL;
+}
@@ -0,0 +1,70 @@
+#ifndef PNG_ROW_WRITER_H
+#define PNG_ROW_WRITER_H
+
+#include <png.h>
+#include <cstdio>
+#include <string>
+
+
+/**
+ * @class PngRowWriter pngrowwriter.h
+ * \brief Row by row writer of 8-bit grey level or RGB PNG image files.
+ */
+class PngRowWriter
+{
+public:
+
+  /**
+   * \brief Creates a PNG row writer.
+   */
+  PngRowWriter ();
+
+  /**
+   * \brief Deletes the PNG row writer (an unfinished file is left truncated).
+   */
+  ~PngRowWriter ();
+
+  /**
+   * \brief Creates a PNG file and writes its header.
+   * Returns false if the file can not be created.
+   * @param filename Name of the PNG file.
+   * @param width Image width.
+   * @param height Image height.
+   * @param channels Count of bytes per pixel (3 for RGB, 1 for grey).
+   */
+  bool open (const std::string &filename, int width, int height,
+             int channels);
+
+  /**
+   * \brief Encodes the next row.
+   * Returns false on encoding error.
+   * @param row Row of width * channels bytes.
+   */
+  bool writeRow (const unsigned char *row);
+
+  /**
+   * \brief Ends the image once all the rows are written and closes the file.
+   * Returns false on encoding error or missing rows.
+   */
+  bool close ();
+
+
+private:
+
+  /** Created file. */
+  FILE *fp;
+  /** Encoder structure. */
+  png_structp png;
+  /** Image information. */
+  png_infop info;
+  /** Image height. */
+  int height;
+  /** Index of the next row. */
+  int rowIndex;
+
+  /**
+   * \brief Releases the encoder and closes the file.
+   */
+  void release ();
+};
+#endif
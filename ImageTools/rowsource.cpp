@@ -0,0 +1,121 @@
+#include "rowsource.h"
+
+
+const int BufferRows::RED_WEIGHT = 4899;
+const int BufferRows::GREEN_WEIGHT = 9617;
+const int BufferRows::BLUE_WEIGHT = 1868;
+const int BufferRows::WEIGHT_SHIFT = 14;
+
+
+BufferRows::BufferRows (const unsigned char *data, int width, int height,
+                        int stride, int channels, bool bgr)
+{
+  this->data = data;
+  this->width = width;
+  this->height = height;
+  this->stride = stride;
+  this->channels = channels;
+  this->bgr = bgr;
+  rowIndex = 0;
+}
+
+
+bool BufferRows::nextRow (unsigned char *row)
+{
+  if (rowIndex >= height) return false;
+  const unsigned char *in = data + rowIndex * stride;
+  if (channels < 3)
+    for (int i = 0; i < width; i++) row[i] = in[i * channels];
+  else
+  {
+    int wfirst = (bgr ? BLUE_WEIGHT : RED_WEIGHT);
+    int wlast = (bgr ? RED_WEIGHT : BLUE_WEIGHT);
+    for (int i = 0; i < width; i++)
+    {
+      row[i] = (unsigned char) ((wfirst * in[0] + GREEN_WEIGHT * in[1]
+                                 + wlast * in[2] + (1 << (WEIGHT_SHIFT - 1)))
+                                >> WEIGHT_SHIFT);
+      in += channels;
+    }
+  }
+  rowIndex ++;
+  return true;
+}
+
+
+DownSampledRows::DownSampledRows (RowSource &source, int factor)
+{
+  src = &source;
+  this->factor = (factor < 1 ? 1 : factor);
+  width = source.getWidth () / this->factor;
+  height = source.getHeight () / this->factor;
+  channels = source.getChannels ();
+  inrow = new unsigned char[source.getWidth () * channels];
+  sums = new int[width * channels];
+}
+
+
+DownSampledRows::~DownSampledRows ()
+{
+  delete [] inrow;
+  delete [] sums;
+}
+
+
+bool DownSampledRows::nextRow (unsigned char *row)
+{
+  for (int i = 0; i < width * channels; i++) sums[i] = 0;
+  for (int k = 0; k < factor; k++)
+  {
+    if (! src->nextRow (inrow)) return false;
+    unsigned char *in = inrow;
+    int *out = sums;
+    for (int i = 0; i < width; i++)
+    {
+      for (int j = 0; j < factor; j++)
+        for (int c = 0; c < channels; c++) out[c] += *in++;
+      out += channels;
+    }
+  }
+  int area = factor * factor;
+  for (int i = 0; i < width * channels; i++)
+    row[i] = (unsigned char) ((sums[i] + area / 2) / area);
+  return true;
+}
+
+
+CroppedRows::CroppedRows (RowSource &source, int x, int y,
+                          int width, int height)
+{
+  src = &source;
+  if (x < 0) { width += x; x = 0; }
+  if (y < 0) { height += y; y = 0; }
+  if (x + width > source.getWidth ()) width = source.getWidth () - x;
+  if (y + height > source.getHeight ()) height = source.getHeight () - y;
+  xmin = x;
+  skipped = y;
+  this->width = (width < 0 ? 0 : width);
+  this->height = (height < 0 ? 0 : height);
+  channels = source.getChannels ();
+  rowIndex = 0;
+  inrow = new unsigned char[source.getWidth () * channels];
+}
+
+
+CroppedRows::~CroppedRows ()
+{
+  delete [] inrow;
+}
+
+
+bool CroppedRows::nextRow (unsigned char *row)
+{
+  if (rowIndex >= height) return false;
+  for (; skipped > 0; skipped --)
+    if (! src->nextRow (inrow)) return false;
+  if (! src->nextRow (inrow)) return false;
+  unsigned char *in = inrow + xmin * channels;
+  for (int i = 0; i < width * channels; i++) row[i] = in[i];
+  rowIndex ++;
+  return true;
+}
@@ -0,0 +1,246 @@
+#ifndef ROW_SOURCE_H
+#define ROW_SOURCE_H
+
+
+/**
+ * @class RowSource rowsource.h
+ * \brief Sequential provider of image rows.
+ * Rows are delivered from top to bottom, one at a time, so that an image
+ *   can be processed without being fully loaded in memory.
+ */
+class RowSource
+{
+public:
+
+  /**
+   * \brief Deletes the row source.
+   */
+  virtual ~RowSource () { }
+
+  /**
+   * \brief Returns the row width in pixels.
+   */
+  virtual int getWidth () const = 0;
+
+  /**
+   * \brief Returns the count of rows.
+   */
+  virtual int getHeight () const = 0;
+
+  /**
+   * \brief Returns the count of bytes per pixel.
+   */
+  virtual int getChannels () const = 0;
+
+  /**
+   * \brief Copies the next row into given buffer.
+   * Returns false if no more row is available.
+   * @param row Output buffer of getWidth () * getChannels () bytes.
+   */
+  virtual bool nextRow (unsigned char *row) = 0;
+};
+
+
+
+/**
+ * @class BufferRows rowsource.h
+ * \brief Grey level row source reading an image buffer.
+ * Colour pixels are converted to grey levels on the fly, with the usual
+ *   0.299 R + 0.587 G + 0.114 B weights in 14-bit fixed point.
+ */
+class BufferRows : public RowSource
+{
+public:
+
+  /**
+   * \brief Creates a grey level row source on an image buffer.
+   * @param data Image buffer.
+   * @param width Image width.
+   * @param height Image height.
+   * @param stride Distance between the starts of two successive rows.
+   * @param channels Count of bytes per pixel (1, 3 or 4).
+   * @param bgr Blue component first if true, red component first otherwise.
+   */
+  BufferRows (const unsigned char *data, int width, int height, int stride,
+              int channels, bool bgr = true);
+
+  /**
+   * \brief Returns the row width in pixels.
+   */
+  inline int getWidth () const { return width; }
+
+  /**
+   * \brief Returns the count of rows.
+   */
+  inline int getHeight () const { return height; }
+
+  /**
+   * \brief Returns the count of bytes per pixel of delivered rows (grey).
+   */
+  inline int getChannels () const { return 1; }
+
+  /**
+   * \brief Copies the next row into given buffer as grey levels.
+   * Returns false if no more row is available.
+   * @param row Output buffer of getWidth () bytes.
+   */
+  bool nextRow (unsigned char *row);
+
+
+private:
+
+  /** Fixed point weight of the red component. */
+  static const int RED_WEIGHT;
+  /** Fixed point weight of the green component. */
+  static const int GREEN_WEIGHT;
+  /** Fixed point weight of the blue component. */
+  static const int BLUE_WEIGHT;
+  /** Fixed point shift of the weights. */
+  static const int WEIGHT_SHIFT;
+
+  /** Image buffer. */
+  const unsigned char *data;
+  /** Image width. */
+  int width;
+  /** Image height. */
+  int height;
+  /** Distance between successive rows. */
+  int stride;
+  /** Count of bytes per pixel. */
+  int channels;
+  /** Blue component first. */
+  bool bgr;
+  /** Index of the next row. */
+  int rowIndex;
+};
+
+/**
+ * @class DownSampledRows rowsource.h
+ * \brief Row source averaging square blocks of another row source.
+ * Incomplete blocks on the right and bottom sides are ignored.
+ */
+class DownSampledRows : public RowSource
+{
+public:
+
+  /**
+   * \brief Creates a down-sampled row source.
+   * @param source Original row source.
+   * @param factor Side of the averaged blocks.
+   */
+  DownSampledRows (RowSource &source, int factor);
+
+  /**
+   * \brief Deletes the down-sampled row source.
+   */
+  ~DownSampledRows ();
+
+  /**
+   * \brief Returns the row width in pixels.
+   */
+  inline int getWidth () const { return width; }
+
+  /**
+   * \brief Returns the count of rows.
+   */
+  inline int getHeight () const { return height; }
+
+  /**
+   * \brief Returns the count of bytes per pixel.
+   */
+  inline int getChannels () const { return channels; }
+
+  /**
+   * \brief Copies the next averaged row into given buffer.
+   * Returns false if no more row is available.
+   * @param row Output buffer of getWidth () * getChannels () bytes.
+   */
+  bool nextRow (unsigned char *row);
+
+
+private:
+
+  /** Original row source. */
+  RowSource *src;
+  /** Side of the averaged blocks. */
+  int factor;
+  /** Row width. */
+  int width;
+  /** Count of rows. */
+  int height;
+  /** Count of bytes per pixel. */
+  int channels;
+  /** Original row buffer. */
+  unsigned char *inrow;
+  /** Block sums buffer. */
+  int *sums;
+};
+
+/**
+ * @class CroppedRows rowsource.h
+ * \brief Row source restricted to a rectangle of another row source.
+ * Rows above the rectangle are read and skipped, rows below are not read.
+ */
+class CroppedRows : public RowSource
+{
+public:
+
+  /**
+   * \brief Creates a cropped row source.
+   * The rectangle is clipped to the original row source.
+   * @param source Original row source.
+   * @param x Left column of the rectangle.
+   * @param y Upper row of the rectangle.
+   * @param width Rectangle width.
+   * @param height Rectangle height.
+   */
+  CroppedRows (RowSource &source, int x, int y, int width, int height);
+
+  /**
+   * \brief Deletes the cropped row source.
+   */
+  ~CroppedRows ();
+
+  /**
+   * \brief Returns the row width in pixels.
+   */
+  inline int getWidth () const { return width; }
+
+  /**
+   * \brief Returns the count of rows.
+   */
+  inline int getHeight () const { return height; }
+
+  /**
+   * \brief Returns the count of bytes per pixel.
+   */
+  inline int getChannels () const { return channels; }
+
+  /**
+   * \brief Copies the next cropped row into given buffer.
+   * Returns false if no more row is available.
+   * @param row Output buffer of getWidth () * getChannels () bytes.
+   */
+  bool nextRow (unsigned char *row);
+
+
+private:
+
+  /** Original row source. */
+  RowSource *src;
+  /** Left column of the rectangle. */
+  int xmin;
+  /** Count of rows to skip before the rectangle. */
+  int skipped;
+  /** Row width. */
+  int width;
+  /** Count of rows. */
+  int height;
+  /** Count of bytes per pixel. */
+  int channels;
+  /** Index of the next row. */
+  int rowIndex;
+  /** Original row buffer. */
+  unsigned char *inrow;
+};
+#endif
@@ -1,9 +1,10 @@
 #include "vmap.h"
 #include <cmath>
+#include <algorithm>
 #include <inttypes.h>
 
 
-const int VMap::TYPE_UNKNOWN = -1;
+const int VMap::TYPE_UNKNOWN = -1;    // same as GradientField types
 const int VMap::TYPE_SOBEL_3X3 = 0;
 const int VMap::TYPE_SOBEL_5X5 = 1;
 
@@ -15,108 +16,68 @@ const int VMap::MAX_BOWL = 20;
 const int VMap::NB_DILATIONS = 5;
 const int VMap::DEFAULT_DILATION = 4;
 
+const int VMap::COLUMN_BLOCK = 64;
+
 
 
 VMap::VMap (int width, int height, unsigned char *data, int type)
 {
-  this->width = width;
-  this->height = height;
-  this->gtype = type;
-  init ();
-  imap = new int[width * height];
-  if (type == TYPE_SOBEL_5X5)
-  {
-    buildSobel5x5Map (data);
-    for (int i = 0; i < width * height; i++)
-      imap[i] = (int) sqrt (map[i].norm2 ());
-    gmagThreshold *= gradientThreshold;
-  }
-  else if (type == TYPE_SOBEL_3X3)
-  {
-    buildSobel3x3Map (data);
-    for (int i = 0; i < width * height; i++)
-      imap[i] = (int) sqrt (map[i].norm2 ());
-    gmagThreshold *= gradientThreshold;
-  }
+  init (new GradientField (width, height, data, type), true);
 }
 
 
 VMap::VMap (int width, int height, int *data, int type)
 {
-  this->width = width;
-  this->height = height;
-  this->gtype = type;
-  init ();
-  imap = new int[width * height];
-  if (type == TYPE_SOBEL_5X5)
-  {
-    buildSobel5x5Map (data);
-    for (int i = 0; i < width * height; i++)
-      imap[i] = (int) sqrt (map[i].norm2 ());
-    gmagThreshold *= gradientThreshold;
-  }
-  else if (type == TYPE_SOBEL_3X3)
-  {
-    buildSobel3x3Map (data);
-    for (int i = 0; i < width * height; i++)
-      imap[i] = (int) sqrt (map[i].norm2 ());
-    gmagThreshold *= gradientThreshold;
-  }
+  init (new GradientField (width, height, data, type), true);
 }
 
 
 VMap::VMap (int width, int height, int **data, int type)
 {
-  this->width = width;
-  this->height = height;
-  this->gtype = type;
-  init ();
-  imap = new int[width * height];
-  if (type == TYPE_SOBEL_5X5)
-  {
-    buildSobel5x5Map (data);
-    for (int i = 0; i < width * height; i++)
-      imap[i] = (int) sqrt (map[i].norm2 ());
-    gmagThreshold *= gradientThreshold;
-  }
-  else if (type == TYPE_SOBEL_3X3)
-  {
-    buildSobel3x3Map (data);
-    for (int i = 0; i < width * height; i++)
-      imap[i] = (int) sqrt (map[i].norm2 ());
-    gmagThreshold *= gradientThreshold;
-  }
+  init (new GradientField (width, height, data, type), true);
+}
+
+
+VMap::VMap (RowSource &source, int type, unsigned char *data)
+{
+  init (new GradientField (source, type, data), true);
 }
 
 
 VMap::VMap (int width, int height, Vr2i *map)
 {
-  this->width = width;
-  this->height = height;
-  this->gtype = TYPE_UNKNOWN;
-  this->map = map;
-  init ();
-  imap = new int[width * height];
-  for (int i = 0; i < width * height; i++)
-    imap[i] = (int) sqrt (map[i].norm2 ());
-  gmagThreshold *= gradientThreshold;
+  init (new GradientField (width, height, map), true);
+}
+
+
+VMap::VMap (const GradientField *field)
+{
+  init (field, false);
 }
 
 
 VMap::~VMap ()
 {
-  delete [] map;
-  delete [] imap;
+  if (ownField) delete field;
   delete [] mask;
   delete [] dilations;
   delete [] bowl;
 }
 
 
-void VMap::init ()
+void VMap::init (const GradientField *field, bool owned)
 {
+  this->field = field;
+  ownField = owned;
+  width = field->getWidth ();
+  height = field->getHeight ();
+  gtype = field->getType ();
+  gx = field->getXPlane ();
+  gy = field->getYPlane ();
+  gmag = field->getMagnitudePlane ();
   gradientThreshold = DEFAULT_GRADIENT_THRESHOLD;
-  gmagThreshold = gradientThreshold;
+  // Same rule for owned and shared fields, and as in incGradientThreshold
+  gmagThreshold = gradientThreshold * gradientThreshold;
   gradres = DEFAULT_GRADIENT_RESOLUTION;
   mask = new bool[width * height];
   for (int i = 0; i < width * height; i++) mask[i] = false;
@@ -154,326 +115,17 @@ void VMap::init ()
 }
 
 
-void VMap::buildSobel3x3Map (unsigned char *data)
-{
-  map = new Vr2i[width * height];
-  Vr2i *gm = map;
-
-  for (int j = 0; j < width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int i = 1; i < height - 1; i++)
-  {
-    gm->set (0, 0);
-    gm++;
-    for (int j = 1; j < width - 1; j++)
-    {
-      gm->set (data[(i - 1) * width + j + 1]
-               + 2 * data[i * width + j + 1]
-               + data[(i + 1) * width + j + 1]
-               - data[(i - 1) * width + j - 1]
-               - 2 * data[i * width + j - 1]
-               - data[(i + 1) * width + j - 1],
-               data[(i + 1) * width + j - 1]
-               + 2 * data[(i + 1) * width + j]
-               + data[(i + 1) * width + j + 1]
-               - data[(i - 1) * width + j - 1]
-               - 2 * data[(i - 1) * width + j]
-               - data[(i - 1) * width + j + 1]);
-      gm++;
-    }
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int j = 0; j < width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-}
-
-
-void VMap::buildSobel3x3Map (int *data)
-{
-  map = new Vr2i[width * height];
-  Vr2i *gm = map;
-
-  for (int j = 0; j < width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int i = 1; i < height - 1; i++)
-  {
-    gm->set (0, 0);
-    gm++;
-    for (int j = 1; j < width - 1; j++)
-    {
-      gm->set (data[(i - 1) * width + j + 1]
-               + 2 * data[i * width + j + 1]
-               + data[(i + 1) * width + j + 1]
-               - data[(i - 1) * width + j - 1]
-               - 2 * data[i * width + j - 1]
-               - data[(i + 1) * width + j - 1],
-               data[(i + 1) * width + j - 1]
-               + 2 * data[(i + 1) * width + j]
-               + data[(i + 1) * width + j + 1]
-               - data[(i - 1) * width + j - 1]
-               - 2 * data[(i - 1) * width + j]
-               - data[(i - 1) * width + j + 1]);
-      gm++;
-    }
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int j = 0; j < width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-}
-
-
-void VMap::buildSobel3x3Map (int **data)
-{
-  map = new Vr2i[width * height];
-  Vr2i *gm = map;
-
-  for (int j = 0; j < width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int i = 1; i < height - 1; i++)
-  {
-    gm->set (0, 0);
-    gm++;
-    for (int j = 1; j < width - 1; j++)
-    {
-      gm->set (data[i-1][j+1] + 2 * data[i][j+1] + data[i+1][j+1]
-               - data[i-1][j-1] - 2 * data[i][j-1] - data[i+1][j-1],
-               data[i+1][j-1] + 2 * data[i+1][j] + data[i+1][j+1]
-               - data[i-1][j-1] - 2 * data[i-1][j] - data[i-1][j+1]);
-      gm++;
-    }
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int j = 0; j < width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-}
-
-
-void VMap::buildSobel5x5Map (unsigned char *data)
-{
-  map = new Vr2i[width * height];
-  Vr2i *gm = map;
-
-  for (int j = 0; j < 2 * width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int i = 2; i < height - 2; i++)
-  {
-    gm->set (0, 0);
-    gm++;
-    gm->set (0, 0);
-    gm++;
-    for (int j = 2; j < width - 2; j++)
-    {
-      gm->set (5 * data[(i - 2) * width + j + 2]
-                 + 8 * data[(i - 1) * width + j + 2]
-                 + 10 * data[i * width + j + 2]
-                 + 8 * data[(i + 1) * width + j + 2]
-                 + 5 * data[(i + 2) * width + j + 2]
-               + 4 * data[(i - 2) * width + j + 1]
-                 + 10 * data[(i - 1) * width + j + 1]
-                 + 20 * data[i * width + j + 1]
-                 + 10 * data[(i + 1) * width + j + 1]
-                 + 4 * data[(i + 2) * width + j + 1]
-               - 4 * data[(i - 2) * width + j - 1]
-                 - 10 * data[(i - 1) * width + j - 1]
-                 - 20 * data[i * width + j - 1]
-                 - 10 * data[(i + 1) * width + j - 1]
-                 - 4 * data[(i + 2) * width + j - 1] 
-               - 5 * data[(i - 2) * width + j - 2]
-                 - 8 * data[(i - 1) * width + j - 2]
-                 - 10 * data[i * width + j - 2]
-                 - 8 * data[(i + 1) * width + j - 2]
-                 - 5 * data[(i + 2) * width + j - 2],
-               5 * data[(i + 2) * width + j - 2]
-                 + 8 * data[(i + 2) * width + j - 1]
-                 + 10 * data[(i + 2) * width + j]
-                 + 8 * data[(i + 2) * width + j + 1]
-                 + 5 * data[(i + 2) * width + j + 2]
-               + 4 * data[(i + 1) * width + j - 2]
-                 + 10 * data[(i + 1) * width + j - 1]
-                 + 20 * data[(i + 1) * width + j]
-                 + 10 * data[(i + 1) * width + j + 1]
-                 + 4 * data[(i + 1) * width + j + 2]
-               - 4 * data[(i - 1) * width + j - 2]
-                 - 10 * data[(i - 1) * width + j - 1]
-                 - 20 * data[(i - 1) * width + j]
-                 - 10 * data[(i - 1) * width + j + 1]
-                 - 4 * data[(i - 1) * width + j + 2]
-               - 5 * data[(i - 2) * width + j - 2]
-                 - 8 * data[(i - 2) * width + j - 1]
-                 - 10 * data[(i - 2) * width + j]
-                 - 8 * data[(i - 2) * width + j + 1]
-                 - 5 * data[(i - 2) * width + j + 2]);
-      gm++;
-    }
-    gm->set (0, 0);
-    gm++;
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int j = 0; j < 2 * width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-}
-
-
-void VMap::buildSobel5x5Map (int *data)
-{
-  map = new Vr2i[width * height];
-  Vr2i *gm = map;
-
-  for (int j = 0; j < 2 * width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int i = 2; i < height - 2; i++)
-  {
-    gm->set (0, 0);
-    gm++;
-    gm->set (0, 0);
-    gm++;
-    for (int j = 2; j < width - 2; j++)
-    {
-      gm->set (5 * data[(i - 2) * width + j + 2]
-                 + 8 * data[(i - 1) * width + j + 2]
-                 + 10 * data[i * width + j + 2]
-                 + 8 * data[(i + 1) * width + j + 2]
-                 + 5 * data[(i + 2) * width + j + 2]
-               + 4 * data[(i - 2) * width + j + 1]
-                 + 10 * data[(i - 1) * width + j + 1]
-                 + 20 * data[i * width + j + 1]
-                 + 10 * data[(i + 1) * width + j + 1]
-                 + 4 * data[(i + 2) * width + j + 1]
-               - 4 * data[(i - 2) * width + j - 1]
-                 - 10 * data[(i - 1) * width + j - 1]
-                 - 20 * data[i * width + j - 1]
-                 - 10 * data[(i + 1) * width + j - 1]
-                 - 4 * data[(i + 2) * width + j - 1] 
-               - 5 * data[(i - 2) * width + j - 2]
-                 - 8 * data[(i - 1) * width + j - 2]
-                 - 10 * data[i * width + j - 2]
-                 - 8 * data[(i + 1) * width + j - 2]
-                 - 5 * data[(i + 2) * width + j - 2],
-               5 * data[(i + 2) * width + j - 2]
-                 + 8 * data[(i + 2) * width + j - 1]
-                 + 10 * data[(i + 2) * width + j]
-                 + 8 * data[(i + 2) * width + j + 1]
-                 + 5 * data[(i + 2) * width + j + 2]
-               + 4 * data[(i + 1) * width + j - 2]
-                 + 10 * data[(i + 1) * width + j - 1]
-                 + 20 * data[(i + 1) * width + j]
-                 + 10 * data[(i + 1) * width + j + 1]
-                 + 4 * data[(i + 1) * width + j + 2]
-               - 4 * data[(i - 1) * width + j - 2]
-                 - 10 * data[(i - 1) * width + j - 1]
-                 - 20 * data[(i - 1) * width + j]
-                 - 10 * data[(i - 1) * width + j + 1]
-                 - 4 * data[(i - 1) * width + j + 2]
-               - 5 * data[(i - 2) * width + j - 2]
-                 - 8 * data[(i - 2) * width + j - 1]
-                 - 10 * data[(i - 2) * width + j]
-                 - 8 * data[(i - 2) * width + j + 1]
-                 - 5 * data[(i - 2) * width + j + 2]);
-      gm++;
-    }
-    gm->set (0, 0);
-    gm++;
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int j = 0; j < 2 * width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-}
-
-
-void VMap::buildSobel5x5Map (int **data)
-{
-  map = new Vr2i[width * height];
-  Vr2i *gm = map;
-
-  for (int j = 0; j < 2 * width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int i = 2; i < height - 2; i++)
-  {
-    gm->set (0, 0);
-    gm++;
-    gm->set (0, 0);
-    gm++;
-    for (int j = 2; j < width - 2; j++)
-    {
-      gm->set (
-        5 * data[i-2][j+2] + 8 * data[i-1][j+2] + 10 * data[i][j+2]
-                           + 8 * data[i+1][j+2] + 5 * data[i+2][j+2]
-        + 4 * data[i-2][j+1] + 10 * data[i-1][j+1] + 20 * data[i][j+1]
-                           + 10 * data[i+1][j+1] + 4 * data[i+2][j+1]
-        - 4 * data[i-2][j-1] - 10 * data[i-1][j-1] - 20 * data[i][j-1]
-                           - 10 * data[i+1][j-1] - 4 * data[i+2][j-1]
-        - 5 * data[i-2][j-2] - 8 * data[i-1][j-2] - 10 * data[i][j-2]
-                           - 8 * data[i+1][j-2] - 5 * data[i+2][j-2],
-        5 * data[i+2][j-2] + 8 * data[i+2][j-1] + 10 * data[i+2][j]
-                           + 8 * data[i+2][j+1] + 5 * data[i+2][j+2]
-        + 4 * data[i+1][j-2] + 10 * data[i+1][j-1] + 20 * data[i+1][j]
-                           + 10 * data[i+1][j+1] + 4 * data[i+1][j+2]
-        - 4 * data[i-1][j-2] - 10 * data[i-1][j-1] - 20 * data[i-1][j]
-                           - 10 * data[i-1][j+1] - 4 * data[i-1][j+2]
-        - 5 * data[i-2][j-2] - 8 * data[i-2][j-1] - 10 * data[i-2][j]
-                           - 8 * data[i-2][j+1] - 5 * data[i-2][j+2]);
-      gm++;
-    }
-    gm->set (0, 0);
-    gm++;
-    gm->set (0, 0);
-    gm++;
-  }
-  for (int j = 0; j < 2 * width; j++)
-  {
-    gm->set (0, 0);
-    gm++;
-  }
-}
-
-
 int VMap::sqNorm (int i, int j) const
 {
-  return (map[j * width + i].norm2 ());
+  int k = j * width + i;
+  return (gx[k] * gx[k] + gy[k] * gy[k]);
 }
 
 
 int VMap::sqNorm (Pt2i p) const
 {
-  return (map[p.y () * width + p.x ()].norm2 ());
+  int k = p.y () * width + p.x ();
+  return (gx[k] * gx[k] + gy[k] * gy[k]);
 }
 
 
@@ -483,13 +135,13 @@ int VMap::largestIn (const std::vector<Pt2i> &pix) const
 
   int imax = -1;
   std::vector<Pt2i>::const_iterator pt = pix.begin ();
-  int gmax = imap[pt->y() * width + pt->x()];
+  int gmax = gmag[pt->y() * width + pt->x()];
   if (gmax < gmagThreshold) gmax = gmagThreshold;
 
   int i = 0;
   while (pt != pix.end ())
   {
-    int g = imap[pt->y() * width + pt->x()];
+    int g = gmag[pt->y() * width + pt->x()];
     if (g > gmax)
     {
       gmax = g;
@@ -577,8 +229,8 @@ int VMap::keepDirectedElementsAs (const std::vector<Pt2i> &pix,
   int i = 0;
   while (i < n)
   {
-    Vr2i gr = map[pix[ind[i]].y () * width + pix[ind[i]].x ()];
-    if (vx * gr.x () + vy * gr.y () <= 0) ind[i] = ind[--n];
+    int k = pix[ind[i]].y () * width + pix[ind[i]].x ();
+    if (vx * gx[k] + vy * gy[k] <= 0) ind[i] = ind[--n];
     else i++;
   }
   return (n);
@@ -596,11 +248,11 @@ int VMap::keepOrientedElementsAs (const std::vector<Pt2i> &pix,
   while (i < n)
   {
     Pt2i p = pix.at (ind[i]);
-    Vr2i gr = map[p.y () * width + p.x ()];
-    int64_t gx = (int64_t) gr.x ();
-    int64_t gy = (int64_t) gr.y ();
-    if ((vx * vx * gx * gx + vy * vy * gy * gy + 2 * vx * vy * gx * gy) * 100
-        < vn2 * (gx * gx + gy * gy) * angleThreshold)
+    int k = p.y () * width + p.x ();
+    int64_t ux = (int64_t) gx[k];
+    int64_t uy = (int64_t) gy[k];
+    if ((vx * vx * ux * ux + vy * vy * uy * uy + 2 * vx * vy * ux * uy) * 100
+        < vn2 * (ux * ux + uy * uy) * angleThreshold)
       ind[i] = ind[--n];
     else i++;
   }
@@ -634,6 +286,110 @@ int VMap::localMax (int *lmax, const std::vector<Pt2i> &pix) const
 }
 
 
+int VMap::localMax (int *lmax, const Pt2i &start, const Vr2i &dir,
+                    int n) const
+{
+  // Builds the gradient norm signal
+  int k0 = start.y () * width + start.x ();
+  int stride = dir.y () * width + dir.x ();
+  int *gn = new int[n];
+  for (int i = 0; i < n; i++) gn[i] = gmag[k0 + i * stride];
+
+  // Gets the local maxima
+  int count = searchLocalMax (lmax, n, gn);
+
+  // Prunes the low contrasted local maxima
+  count = keepContrastedMax (lmax, count, gn);
+  delete [] gn;
+
+  // Prunes the already selected candidates and sorts the others
+  return (keepFreeSortedMax (lmax, count, start, dir));
+}
+
+
+void VMap::columnLocalMax (std::vector<int> &lmax, std::vector<int> &first,
+                           const std::vector<int> &cols,
+                           int ymin, int ymax) const
+{
+  int n = ymax - ymin + 1;
+  int nbcols = (int) cols.size ();
+  first.resize (nbcols + 1);
+  int *gn = new int[COLUMN_BLOCK * n];
+  int *lm = new int[n];
+
+  for (int c0 = 0; c0 < nbcols; c0 += COLUMN_BLOCK)
+  {
+    int nb = (nbcols - c0 < COLUMN_BLOCK ? nbcols - c0 : COLUMN_BLOCK);
+
+    // Gathers the column signals row by row
+    for (int i = 0; i < n; i++)
+    {
+      const uint16_t *row = gmag + (ymin + i) * width;
+      for (int c = 0; c < nb; c++) gn[c * n + i] = row[cols[c0 + c]];
+    }
+
+    // Gets the contrasted local maxima of each column
+    for (int c = 0; c < nb; c++)
+    {
+      first[c0 + c] = (int) lmax.size ();
+      int count = searchLocalMax (lm, n, gn + c * n);
+      count = keepContrastedMax (lm, count, gn + c * n);
+      lmax.insert (lmax.end (), lm, lm + count);
+    }
+  }
+  first[nbcols] = (int) lmax.size ();
+  delete [] lm;
+  delete [] gn;
+}
+
+
+void VMap::rowLocalMax (std::vector<int> &lmax, std::vector<int> &first,
+                        const std::vector<int> &rows,
+                        int xmin, int xmax) const
+{
+  int n = xmax - xmin + 1;
+  int nbrows = (int) rows.size ();
+  first.resize (nbrows + 1);
+  int *gn = new int[n];
+  int *lm = new int[n];
+
+  for (int r = 0; r < nbrows; r++)
+  {
+    const uint16_t *row = gmag + rows[r] * width + xmin;
+    for (int i = 0; i < n; i++) gn[i] = row[i];
+    first[r] = (int) lmax.size ();
+    int count = searchLocalMax (lm, n, gn);
+    count = keepContrastedMax (lm, count, gn);
+    lmax.insert (lmax.end (), lm, lm + count);
+  }
+  first[nbrows] = (int) lmax.size ();
+  delete [] lm;
+  delete [] gn;
+}
+
+
+int VMap::keepFreeSortedMax (int *lmax, int n,
+                             const Pt2i &start, const Vr2i &dir) const
+{
+  int k0 = start.y () * width + start.x ();
+  int stride = dir.y () * width + dir.x ();
+
+  // Prunes the already selected candidates
+  int i = 0;
+  while (i < n)
+  {
+    if (mask[k0 + lmax[i] * stride]) lmax[i] = lmax[--n];
+    else i++;
+  }
+
+  // Sorts candidates by gradient magnitude (stable ordering)
+  const uint16_t *val = gmag + k0;
+  std::stable_sort (lmax, lmax + n, [val, stride] (int a, int b) {
+                      return (val[a * stride] > val[b * stride]); });
+  return n;
+}
+
+
 int VMap::localMax (int *lmax, const std::vector<Pt2i> &pix,
                     const Vr2i &gref) const
 {
@@ -727,21 +483,9 @@ int VMap::searchLocalMax (int *lmax, int n, int *in) const
 
 void VMap::sortMax (int *lmax, int n, int *val) const
 {
-  for (int i = 1; i < n; i ++)
-  {
-    int j = i, tmp = lmax[i];
-    bool on = true;
-    while (on && j > 0)
-    {
-      if (val[tmp] > val[lmax[j-1]])
-      {
-        lmax[j] = lmax[j-1];
-        j --;
-      }
-      else on = false;
-    }
-    lmax[j] = tmp;
-  }
+  // Stable ordering : equal magnitudes keep their relative order
+  std::stable_sort (lmax, lmax + n,
+                    [val] (int a, int b) { return (val[a] > val[b]); });
 }
 
 
@@ -751,6 +495,17 @@ void VMap::clearMask ()
 }
 
 
+void VMap::clearMask (int xmin, int ymin, int xmax, int ymax)
+{
+  if (xmin < 0) xmin = 0;
+  if (ymin < 0) ymin = 0;
+  if (xmax >= width) xmax = width - 1;
+  if (ymax >= height) ymax = height - 1;
+  for (int j = ymin; j <= ymax; j++)
+    for (int i = xmin; i <= xmax; i++) mask[j * width + i] = false;
+}
+
+
 void VMap::setMask (const std::vector<Pt2i> &pts)
 {
   std::vector<Pt2i>::const_iterator it = pts.begin ();
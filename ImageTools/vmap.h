@@ -1,12 +1,16 @@
 #ifndef VMAP_H
 #define VMAP_H
 
-#include "pt2i.h"
+#include "gradientfield.h"
 
 
 /** 
  * @class VMap vmap.h
  * \brief Map of 2D vectors.
+ * The vectors are read in an immutable gradient field, owned by the map
+ *   or shared with other maps. The map only adds the detection state
+ *   (occupancy mask and selection thresholds), so that several detectors
+ *   can run on a same gradient field.
  */
 class VMap
 {
@@ -46,19 +50,42 @@ public:
    */
   VMap (int width, int height, int **data, int type = 0);
 
+  /** 
+   * \brief Creates a gradient map from grey level rows.
+   * Rows are read once, only the rows covered by the gradient kernel being
+   *   kept in a ring buffer.
+   * @param source Grey level row source.
+   * @param type Gradient extraction method (default is Sobel with 3x3 kernel).
+   * @param data Output scalar data array, filled with the rows if not null.
+   */
+  VMap (RowSource &source, int type = 0, unsigned char *data = NULL);
+
   /** 
    * \brief Creates a gradient map from given vector map.
+   * The vector map is copied in the compact planes, then deleted.
    * @param width Map width.
    * @param height Map height.
    * @param map Vector map.
    */
   VMap (int width, int height, Vr2i *map);
 
+  /** 
+   * \brief Creates a vector map on a shared gradient field.
+   * The gradient field is not deleted with the map.
+   * @param field Gradient field.
+   */
+  VMap (const GradientField *field);
+
   /** 
    * \brief Deletes the vector map.
    */
   ~VMap ();
 
+  /** 
+   * \brief Returns the gradient field of the map.
+   */
+  inline const GradientField *getField () const { return field; }
+
   /** 
    * \brief Returns the map width.
    */
@@ -85,23 +112,21 @@ public:
     return (i >= 0 && i < width && j >= 0 && j < height);
   }
 
-  /**
-   * \brief Returns a pointer to the vectors of the map.
-   */
-  inline Vr2i *getVectorMap () const { return (map); }
-
   /**
    * \brief Returns the vector at pixel (i,j).
    * @param i Column index of the pixel.
    * @param j Raw index of the pixel.
    */
-  inline Vr2i getValue (int i, int j) const { return (map[j * width + i]); }
+  inline Vr2i getValue (int i, int j) const {
+    return (Vr2i (gx[j * width + i], gy[j * width + i])); }
 
   /**
    * \brief Returns the vector at given position.
    * @param p Pixel position.
    */
-  inline Vr2i getValue (Pt2i p) const { return (map[p.y () * width + p.x ()]); }
+  inline Vr2i getValue (Pt2i p) const {
+    int k = p.y () * width + p.x ();
+    return (Vr2i (gx[k], gy[k])); }
 
   /**
    * \brief Returns the squared norm of the vector magnitude at pixel (i,j).
@@ -121,13 +146,13 @@ public:
    * @param i Column index of the pixel.
    * @param j Raw index of the pixel.
    */
-  inline int magn (int i, int j) const { return (imap[j * width + i]); }
+  inline int magn (int i, int j) const { return (gmag[j * width + i]); }
 
   /**
    * \brief Returns comparable norm of the vector magnitude at given position.
    * @param p Pixel position.
    */
-  inline int magn (Pt2i p) const { return (imap[p.y () * width + p.x ()]); }
+  inline int magn (Pt2i p) const { return (gmag[p.y () * width + p.x ()]); }
 
   /** 
    * \brief Returns the index of the largest vector at given positions.
@@ -192,6 +217,60 @@ public:
    */
   int localMax (int *lmax, const std::vector<Pt2i> &pix) const;
 
+  /**
+   * \brief Gets filtered and sorted local gradient maxima along a straight
+   *   horizontal or vertical run of pixels.
+   * Same as on the set of run pixels, but magnitudes are read directly
+   *   in the map without building the pixel set.
+   * Local max already used are pruned.
+   * Returns the count of found gradient maxima.
+   * @param lmax Ouput local max index array (indices along the run).
+   * @param start First pixel of the run.
+   * @param dir Unit step of the run (along X or Y axis).
+   * @param n Count of pixels in the run.
+   */
+  int localMax (int *lmax, const Pt2i &start, const Vr2i &dir, int n) const;
+
+  /**
+   * \brief Gets contrasted local gradient maxima along a set of columns.
+   * Magnitudes are gathered by blocks of columns in a single pass over the
+   *   map rows, then local maxima are searched in each column, and the low
+   *   contrasted ones are pruned. Local max are neither masked nor sorted.
+   * @param lmax Output local max indices (from column bottom), appended.
+   * @param first Output start of each column local max in lmax
+   *   (cols.size () + 1 entries).
+   * @param cols Column indices.
+   * @param ymin Bottom line of the columns.
+   * @param ymax Top line of the columns.
+   */
+  void columnLocalMax (std::vector<int> &lmax, std::vector<int> &first,
+                       const std::vector<int> &cols, int ymin, int ymax) const;
+
+  /**
+   * \brief Gets contrasted local gradient maxima along a set of rows.
+   * Local max are neither masked nor sorted.
+   * @param lmax Output local max indices (from row left end), appended.
+   * @param first Output start of each row local max in lmax
+   *   (rows.size () + 1 entries).
+   * @param rows Line indices.
+   * @param xmin Left column of the rows.
+   * @param xmax Right column of the rows.
+   */
+  void rowLocalMax (std::vector<int> &lmax, std::vector<int> &first,
+                    const std::vector<int> &rows, int xmin, int xmax) const;
+
+  /**
+   * \brief Prunes already used local max along a straight horizontal or
+   *   vertical run of pixels and sorts the others by gradient magnitude.
+   * Returns the count of remaining local max.
+   * @param lmax Local max index array (indices along the run).
+   * @param n Count of local max.
+   * @param start First pixel of the run.
+   * @param dir Unit step of the run (along X or Y axis).
+   */
+  int keepFreeSortedMax (int *lmax, int n,
+                         const Pt2i &start, const Vr2i &dir) const;
+
   /**
    * \brief Gets filtered and sorted local oriented gradient maxima.
    * Local maxima are filtered according to the gradient direction and sorted.
@@ -245,6 +324,16 @@ public:
    */
   void clearMask ();
 
+  /**
+   * \brief Clears the occupancy mask inside a rectangular area.
+   * The area is clipped to the map bounds.
+   * @param xmin Left column of the area.
+   * @param ymin Lower line of the area.
+   * @param xmax Right column of the area.
+   * @param ymax Upper line of the area.
+   */
+  void clearMask (int xmin, int ymin, int xmax, int ymax);
+
   /**
    * \brief Adds pixels to the occupancy mask.
    * @param pts Vector of pixels.
@@ -291,16 +380,22 @@ private:
   /** Default dilation for the points added to the mask. */
   static const int DEFAULT_DILATION;
 
+  /** Gradient field. */
+  const GradientField *field;
+  /** Ownership of the gradient field. */
+  bool ownField;
   /** Image width. */
   int width;
   /** Image height. */
   int height;
   /** Gradient type. */
   int gtype;
-  /** Vector map. */
-  Vr2i *map;
-  /** Magnitude map (squared norm). */
-  int *imap;
+  /** Vector map X components (gradient field plane). */
+  const int16_t *gx;
+  /** Vector map Y components (gradient field plane). */
+  const int16_t *gy;
+  /** Magnitude map (gradient field plane). */
+  const uint16_t *gmag;
 
   /** Effective value for the angular deviation test. */
   int angleThreshold;
@@ -327,50 +422,10 @@ private:
 
   /** 
    * \brief Initializes the internal data of the vector map.
+   * @param field Gradient field of the map.
+   * @param owned Ownership of the gradient field.
    */
-  void init ();
-
-  /** 
-   * \brief Builds the vector map as a gradient map from provided data.
-   * Uses a Sobel 3x3 kernel by default.
-   * @param data Initial scalar data.
-   */
-  void buildSobel3x3Map (unsigned char *data);
-
-  /** 
-   * \brief Builds the vector map as a gradient map from provided data.
-   * Uses a Sobel 3x3 kernel by default.
-   * @param data Initial scalar data.
-   */
-  void buildSobel3x3Map (int *data);
-
-  /** 
-   * \brief Builds the vector map as a gradient map from provided data.
-   * Uses a Sobel 3x3 kernel by default.
-   * @param data Initial bi-dimensional scalar data.
-   */
-  void buildSobel3x3Map (int **data);
-
-  /** 
-   * \brief Builds the vector map as a gradient map from provided data.
-   * Uses a Sobel 5x5 kernel.
-   * @param data Initial scalar data.
-   */
-  void buildSobel5x5Map (unsigned char *data);
-
-  /** 
-   * \brief Builds the vector map as a gradient map from provided data.
-   * Uses a Sobel 5x5 kernel.
-   * @param data Initial scalar data.
-   */
-  void buildSobel5x5Map (int *data);
-
-  /** 
-   * \brief Builds the vector map as a gradient map from provided data.
-   * Uses a Sobel 5x5 kernel.
-   * @param data Initial bi-dimensional scalar data.
-   */
-  void buildSobel5x5Map (int **data);
+  void init (const GradientField *field, bool owned);
 
   /**
    * \brief Searches local gradient maxima values.
@@ -383,11 +438,16 @@ private:
 
   /**
    * \brief Sorts the candidates array by highest magnitude.
+   * The sort is stable and in O(n log n): candidates of equal magnitude
+   *   keep their order along the stroke.
    * @param lmax Local max index array.
    * @param n Size of index array.
    * @param val Input values.
    */
   void sortMax (int *lmax, int n, int *val) const;
 
+  /** Count of columns gathered together in bulk local max search. */
+  static const int COLUMN_BLOCK;
+
 };
 #endif
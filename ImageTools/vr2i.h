@@ -132,6 +132,14 @@ public:
    */
   bool orientedAs (const Vr2i &ref) const;
 
+  /**
+   * \brief Checks whether the vector lies in a window around X or Y axis.
+   * @param slope Tangent of the window half angle, in percent.
+   */
+  inline bool isAxisAligned (int slope) const {
+    int x = (xv < 0 ? -xv : xv), y = (yv < 0 ? -yv : yv);
+    return (100 * y <= slope * x || 100 * x <= slope * y); }
+
   /**
    * \brief Sets the vector to its opposite.
    */
@@ -0,0 +1,85 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+/**
+ * @class BoundedQueue boundedqueue.h
+ * \brief Blocking FIFO queue of limited capacity between pipeline stages.
+ * Producers wait while the queue is full, consumers wait while it is empty.
+ * Once closed, remaining elements can still be popped.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+
+  /**
+   * \brief Creates an empty queue.
+   * @param capacity Maximal number of queued elements.
+   */
+  BoundedQueue (int capacity) : cap (capacity < 1 ? 1 : capacity),
+                                closed (false) { }
+
+  /**
+   * \brief Appends an element, waiting while the queue is full.
+   * Returns false if the queue is closed (the element is then dropped).
+   * @param elt Element to append.
+   */
+  bool push (const T &elt)
+  {
+    std::unique_lock<std::mutex> lock (mtx);
+    notFull.wait (lock, [this] { return closed || (int) elts.size () < cap; });
+    if (closed) return false;
+    elts.push_back (elt);
+    notEmpty.notify_one ();
+    return true;
+  }
+
+  /**
+   * \brief Removes the first element, waiting while the queue is empty.
+   * Returns false if the queue is closed and empty.
+   * @param elt Removed element.
+   */
+  bool pop (T &elt)
+  {
+    std::unique_lock<std::mutex> lock (mtx);
+    notEmpty.wait (lock, [this] { return closed || ! elts.empty (); });
+    if (elts.empty ()) return false;
+    elt = elts.front ();
+    elts.pop_front ();
+    notFull.notify_one ();
+    return true;
+  }
+
+  /**
+   * \brief Closes the queue: no more element can be appended.
+   */
+  void close ()
+  {
+    std::lock_guard<std::mutex> lock (mtx);
+    closed = true;
+    notEmpty.notify_all ();
+    notFull.notify_all ();
+  }
+
+
+private:
+
+  /** Maximal number of queued elements. */
+  int cap;
+  /** Closure status. */
+  bool closed;
+  /** Queued elements. */
+  std::deque<T> elts;
+  /** Access lock. */
+  std::mutex mtx;
+  /** Signal for waiting consumers. */
+  std::condition_variable notEmpty;
+  /** Signal for waiting producers. */
+  std::condition_variable notFull;
+};
+#endif
@@ -0,0 +1,168 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/**
+ * @class TaskPool taskpool.h
+ * \brief Pool of helper threads running the independent tasks of page extractions.
+ * Threads processing a page register as busy, and helpers only run tasks while
+ *   the count of busy threads is lower than the pool capacity, so that pages
+ *   processed in parallel share the same cores as their tasks.
+ * The thread that submits tasks runs those no helper took, and may submit
+ *   tasks again from inside a task.
+ */
+class TaskPool
+{
+public:
+
+  /**
+   * \brief Creates a pool and starts its helper threads.
+   * @param capacity Maximal count of threads running pages or tasks at once.
+   */
+  TaskPool (int capacity) : cap (capacity < 1 ? 1 : capacity),
+                            busy (0), stopped (false)
+  {
+    for (int i = 1; i < cap; i++)
+      helpers.push_back (std::thread ([this] { help (); }));
+  }
+
+  /**
+   * \brief Stops the helper threads and deletes the pool.
+   */
+  ~TaskPool ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mtx);
+      stopped = true;
+    }
+    wake.notify_all ();
+    for (int i = 0; i < (int) helpers.size (); i++) helpers[i].join ();
+  }
+
+  /**
+   * \brief Returns the maximal count of threads running at once.
+   */
+  inline int capacity () const { return cap; }
+
+  /**
+   * \brief Registers the calling thread as busy with a page.
+   */
+  void enter ()
+  {
+    std::lock_guard<std::mutex> lock (mtx);
+    busy ++;
+  }
+
+  /**
+   * \brief Unregisters the calling thread, letting helpers run pending tasks.
+   */
+  void leave ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mtx);
+      busy --;
+    }
+    wake.notify_all ();
+  }
+
+  /**
+   * \brief Runs independent tasks and returns when all of them are done.
+   * @param tasks Tasks to run, which must not throw.
+   */
+  void run (const std::vector<std::function<void ()> > &tasks)
+  {
+    if (tasks.empty ()) return;
+    Group group (tasks);
+    std::unique_lock<std::mutex> lock (mtx);
+    groups.push_back (&group);
+    wake.notify_all ();
+    while (group.next < (int) tasks.size ())
+    {
+      int task = claim (&group);
+      lock.unlock ();
+      tasks[task] ();
+      lock.lock ();
+      group.left --;
+    }
+    finished.wait (lock, [&group] { return group.left == 0; });
+  }
+
+
+private:
+
+  /** Tasks submitted by a same call. */
+  struct Group
+  {
+    /** Tasks to run. */
+    const std::vector<std::function<void ()> > &tasks;
+    /** Index of the next task to run. */
+    int next;
+    /** Count of tasks not yet done. */
+    int left;
+
+    Group (const std::vector<std::function<void ()> > &t)
+      : tasks (t), next (0), left ((int) t.size ()) { }
+  };
+
+  /** Maximal count of threads running pages or tasks at once. */
+  int cap;
+  /** Count of threads running pages or tasks. */
+  int busy;
+  /** Stop status of the helpers. */
+  bool stopped;
+  /** Groups holding tasks not yet started. */
+  std::deque<Group*> groups;
+  /** Helper threads. */
+  std::vector<std::thread> helpers;
+  /** Access lock. */
+  std::mutex mtx;
+  /** Signal for waiting helpers. */
+  std::condition_variable wake;
+  /** Signal for threads waiting for their tasks. */
+  std::condition_variable finished;
+
+
+  /**
+   * \brief Takes the next task of a group, to be called under the lock.
+   * The group is withdrawn once all of its tasks are taken.
+   * @param group Group of the task.
+   */
+  int claim (Group *group)
+  {
+    int task = group->next ++;
+    if (group->next == (int) group->tasks.size ())
+      groups.erase (std::find (groups.begin (), groups.end (), group));
+    return task;
+  }
+
+  /**
+   * \brief Runs the pending tasks while the pool is not saturated.
+   */
+  void help ()
+  {
+    std::unique_lock<std::mutex> lock (mtx);
+    while (true)
+    {
+      wake.wait (lock, [this] {
+        return stopped || (! groups.empty () && busy < cap); });
+      if (stopped) return;
+      Group *group = groups.front ();
+      int task = claim (group);
+      busy ++;
+      lock.unlock ();
+      group->tasks[task] ();
+      lock.lock ();
+      busy --;
+      if (-- group->left == 0) finished.notify_all ();
+    }
+  }
+};
+#endif
@@ -1,7 +1,14 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <iterator>     // std::istreambuf_iterator
 
 #include <numeric>      // std::iota
 #include <algorithm>    // std::sort, std::stable_sort
@@ -11,6 +18,11 @@
 #include "opencv2/highgui/highgui.hpp"
 
 #include "bsdetector.h"
+#include "tileddetector.h"
+#include "boundedqueue.h"
+#include "taskpool.h"
+#include "pngrowreader.h"
+#include "pngrowwriter.h"
 #include "blurredsegment.h"
 
 using namespace cv;
@@ -18,51 +30,175 @@ using namespace std;
 
 #include "CLI11.hpp"
 
+/**
+ * @brief Counters of the work saved by the approximate accelerations of the segment detection
+ */
+struct DetectionCounts {
+  int skippedTrials = 0; //trials skipped by the failure cache
+  int filteredSeeds = 0; //seeds rejected by the seed pre-filter
+};
+
 /**
  * @brief Detect straight line segment using FBSD detector
  * @param grayImg : input image
+ * @param axisWindow : if not null, only segments within this angle (degree) of horizontal or vertical are detected
+ * @param areas : if not empty, detection is restricted to these boxes (top-left and bottom-right corners)
+ * @param deadline : if not null, time budget (ms) after which detection stops with the segments found so far
+ * @param truncated : if not null, set to true when detection was stopped by the deadline
+ * @param tileBudget : if not null, memory budget (MB) of the gradient map of a tile, the image is then processed by tiles
+ *   (the image itself is not bounded, and tiles keep a minimal size)
+ * @param failureCache : if true, seeds close to already failed seeds are not tried
+ * @param seedFilter : if true, seeds on edges running along the sweep stroke are not tried
+ * @param adaptiveSweep : if true, fine sweep strokes are only used around long segments found by coarse ones
+ * @param counts : if not null, incremented with the work saved by the accelerations
  * @return vector of pair of points
  */
 std::vector<std::pair<Pt2i, Pt2i> >
-FBSDDetector(const Mat& grayImg) {
-  // Copy image
-  int width = grayImg.cols;
-  int height = grayImg.rows;
-  int **tabImage = new int *[height];
-  uchar c;
-  for (int y = 0; y < height; y++) {
-    tabImage[y] = new int[width];
-    for (int x = 0; x < width; x++) {
-      c = grayImg.at<uchar>(Point(x, y));
-      tabImage[y][x] = int(c);
-    }
+FBSDDetector(const Mat& grayImg, double axisWindow = 0,
+             const std::vector<std::pair<Pt2i, Pt2i> >& areas = std::vector<std::pair<Pt2i, Pt2i> >(),
+             int deadline = 0, bool* truncated = NULL, int tileBudget = 0,
+             bool failureCache = false, bool seedFilter = false,
+             bool adaptiveSweep = false, DetectionCounts* counts = NULL) {
+  // Create the FBSD detector, gradient maps are built tile by tile
+  TiledDetector tiledDetector;
+  tiledDetector.setMemoryBudget(tileBudget);
+  BSDetector* detector = tiledDetector.getDetector();
+  detector->setAssignedThickness(1);
+  detector->setAxisAlignedWindow(axisWindow);
+  detector->setTimeBudget(deadline);
+  if(failureCache != detector->isFailureCacheOn())
+    detector->switchFailureCache();
+  if(seedFilter != detector->isSeedFilterOn())
+    detector->switchSeedFilter();
+  if(adaptiveSweep != detector->isAdaptiveSweepOn())
+    detector->switchAdaptiveSweep();
+  // Call Fbsd detector
+  detector->resetMaxDetections ();
+  if(areas.empty())
+    tiledDetector.detectAll(grayImg.ptr<uchar>(0), grayImg.cols, grayImg.rows, int(grayImg.step[0]));
+  else
+    tiledDetector.detectAllInAreas(grayImg.ptr<uchar>(0), grayImg.cols, grayImg.rows, int(grayImg.step[0]), areas);
+  if(truncated != NULL)
+    *truncated = tiledDetector.isTruncated();
+  if(counts != NULL) {
+    counts->skippedTrials += tiledDetector.countOfSkippedTrials();
+    counts->filteredSeeds += tiledDetector.countOfFilteredSeeds();
   }
-  // Generate grandient map for the dectetor
-  VMap *gMap = NULL;
-  if (gMap != NULL) delete gMap;
-  // Create the gradient map
-  gMap = new VMap(width, height, tabImage, VMap::TYPE_SOBEL_5X5);
-  Mat gradImg(Size(width,height),CV_8UC1);
-  for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
-      gradImg.at<uchar>(Point(x, y)) = gMap->magn(x,y);
+  // Retrieve the detected blurred segments
+  const std::vector<std::pair<Pt2i, Pt2i> >& blurredSegments = tiledDetector.getSegments();
+  const std::vector<int>& sizes = tiledDetector.getSegmentSizes();
+  
+  std::vector<std::pair<Pt2i, Pt2i> > seg;
+  for(int it=0; it<blurredSegments.size(); it++) {
+    Pt2i lp = blurredSegments.at(it).first;
+    Pt2i rp = blurredSegments.at(it).second;
+    double den = double(sizes.at(it))/sqrt(lp.vectorTo(rp).norm2());
+    if (den>0.9)
+      seg.push_back(std::make_pair(lp, rp));
+  }
+  return seg;
+}
+
+/**
+ * @brief Check that boxes are apart from each other
+ * @param boxes : boxes (top-left and bottom-right corners)
+ * @param gap : min count of pixels between two boxes
+ */
+bool
+areApart(const std::vector<std::pair<Pt2i, Pt2i> >& boxes,
+         int gap) {
+  for(int i=0; i<boxes.size(); i++)
+    for(int j=i+1; j<boxes.size(); j++)
+      if(boxes[i].second.x() + gap >= boxes[j].first.x() && boxes[j].second.x() + gap >= boxes[i].first.x()
+         && boxes[i].second.y() + gap >= boxes[j].first.y() && boxes[j].second.y() + gap >= boxes[i].first.y())
+        return false;
+  return true;
+}
+
+/**
+ * @brief Detect straight line segment using FBSD detector on a gradient map
+ * Areas apart from each other are detected in parallel on the pool, each one on its own map
+ * sharing the gradient field, which gives the same segments as a single detection: the
+ * trackers are bounded to their area and the masks do not spread further than 2 pixels.
+ * @param gMap : gradient map of the input image
+ * @param axisWindow : if not null, only segments within this angle (degree) of horizontal or vertical are detected
+ * @param areas : if not empty, detection is restricted to these boxes (top-left and bottom-right corners)
+ * @param deadline : if not null, time budget (ms) after which detection stops with the segments found so far
+ * @param truncated : if not null, set to true when detection was stopped by the deadline
+ * @param failureCache : if true, seeds close to already failed seeds are not tried
+ * @param seedFilter : if true, seeds on edges running along the sweep stroke are not tried
+ * @param adaptiveSweep : if true, fine sweep strokes are only used around long segments found by coarse ones
+ * @param strokes : if not empty, segments are only searched across these strokes instead of sweeping the image
+ * @param counts : if not null, incremented with the work saved by the accelerations
+ * @param pool : if not null, task pool of the parallel detection of the areas
+ * @return vector of pair of points
+ */
+std::vector<std::pair<Pt2i, Pt2i> >
+FBSDDetector(VMap* gMap, double axisWindow = 0,
+             const std::vector<std::pair<Pt2i, Pt2i> >& areas = std::vector<std::pair<Pt2i, Pt2i> >(),
+             int deadline = 0, bool* truncated = NULL, bool failureCache = false,
+             bool seedFilter = false, bool adaptiveSweep = false,
+             const std::vector<std::pair<Pt2i, Pt2i> >& strokes = std::vector<std::pair<Pt2i, Pt2i> >(),
+             DetectionCounts* counts = NULL,
+             TaskPool* pool = NULL) {
+  // Parallel detection of the areas, not with a deadline or failed seeds shared by all the areas
+  if(pool != NULL && strokes.empty() && areas.size() > 1 && deadline == 0 && !failureCache
+     && areApart(areas, 4)) {
+    std::vector<std::vector<std::pair<Pt2i, Pt2i> > > areaSeg(areas.size());
+    std::vector<DetectionCounts> areaCounts(areas.size());
+    std::vector<std::function<void()> > tasks;
+    for(int it=0; it<areas.size(); it++)
+      tasks.push_back([&, it]() {
+        VMap areaMap(gMap->getField());
+        std::vector<std::pair<Pt2i, Pt2i> > area(1, areas[it]);
+        areaSeg[it] = FBSDDetector(&areaMap, axisWindow, area, 0, NULL, false, seedFilter, adaptiveSweep,
+                                   strokes, &areaCounts[it]);
+      });
+    pool->run(tasks);
+    std::vector<std::pair<Pt2i, Pt2i> > seg;
+    for(int it=0; it<areas.size(); it++) {
+      seg.insert(seg.end(), areaSeg[it].begin(), areaSeg[it].end());
+      if(counts != NULL)
+        counts->filteredSeeds += areaCounts[it].filteredSeeds;
     }
+    if(truncated != NULL)
+      *truncated = false;
+    return seg;
   }
+  
   // Create the FBSD detector
   BSDetector detector;
   detector.setGradientMap(gMap);
   detector.setAssignedThickness(1);
+  detector.setAxisAlignedWindow(axisWindow);
+  detector.setTimeBudget(deadline);
+  if(failureCache != detector.isFailureCacheOn())
+    detector.switchFailureCache();
+  if(seedFilter != detector.isSeedFilterOn())
+    detector.switchSeedFilter();
+  if(adaptiveSweep != detector.isAdaptiveSweepOn())
+    detector.switchAdaptiveSweep();
   // Call Fbsd detector
   detector.resetMaxDetections ();
-  detector.detectAll();
+  if(!strokes.empty())
+    detector.detectAllOnStrokes(strokes);
+  else if(areas.empty())
+    detector.detectAll();
+  else
+    detector.detectAllInAreas(areas);
+  if(truncated != NULL)
+    *truncated = detector.isTruncated();
+  if(counts != NULL) {
+    counts->skippedTrials += detector.countOfSkippedTrials();
+    counts->filteredSeeds += detector.countOfFilteredSeeds();
+  }
   // Retrieve the detected blurred segments
   vector<BlurredSegment *> blurredSegments = detector.getBlurredSegments();
   
   std::vector<std::pair<Pt2i, Pt2i> > seg;
   for(int it=0; it<blurredSegments.size(); it++) {
     BlurredSegment * bs = blurredSegments.at(it);
-    vector<Pt2i> pts = bs->getAllPoints();
-    double den = double(pts.size())/sqrt(bs->getSquarredLength());
+    double den = double(bs->size())/sqrt(bs->getSquarredLength());
     if (den>0.9) {
       Pt2i lp = bs->getLastLeft();
       Pt2i rp = bs->getLastRight();
@@ -98,120 +234,126 @@ isVerticalSegment(Pt2i p1, Pt2i p2, double tol = 10) {
   return tan(b/a) < tol*M_PI/360.0;
 }
 
+/**
+ * @brief Group collinear and nearby fragments of horizontal (vertical) segments
+ * A fragment is grouped with the fragments starting less than tolDistGr after its end
+ * (or along it) close to its support line. Fragments are registered in buckets of their
+ * across coordinate (y for horizontal fragments, x for vertical ones) widened by this
+ * reach, so that only fragments sharing a bucket are compared, and grouped by union-find.
+ * @param seg : fragments oriented from left to right (top to bottom)
+ * @param vertical : true for vertical fragments
+ * @param tolAngle : tolerance angle of the offset between two grouped fragments
+ * @param tolDistGr : tolerance distance between two grouped fragments
+ * @param tolLen : tolerance of the cumulated length of the fragments of a group
+ * @param tolOffset : tolerance offset between two grouped fragments
+ * @param bucketSize : height (width) of the buckets
+ * @return vector of grouped segments, joining the outermost ends of their fragments
+ */
+std::vector<std::pair<Pt2i, Pt2i> >
+groupCollinearSegments(const std::vector<std::pair<Pt2i, Pt2i> >& seg,
+                       bool vertical,
+                       double tolAngle = 2.5,
+                       int tolDistGr = 20,
+                       int tolLen = 30,
+                       int tolOffset = 2,
+                       int bucketSize = 8) {
+  std::vector<std::pair<Pt2i, Pt2i> > groups;
+  int n = seg.size();
+  if(n == 0)
+    return groups;
+  auto along = [vertical](const Pt2i& p) { return vertical ? p.y() : p.x(); };
+  auto across = [vertical](const Pt2i& p) { return vertical ? p.x() : p.y(); };
+  
+  //Sort fragments by across then along coordinate of their first end
+  vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int i, int j) {
+    int ci = across(seg[i].first), cj = across(seg[j].first);
+    return ci < cj || (ci == cj && along(seg[i].first) < along(seg[j].first));
+  });
+  vector<int> start(n), end(n), startAcross(n), endAcross(n);
+  for(int i=0; i<n; i++) {
+    start[i] = along(seg[order[i]].first);
+    end[i] = along(seg[order[i]].second);
+    startAcross[i] = across(seg[order[i]].first);
+    endAcross[i] = across(seg[order[i]].second);
+  }
+  
+  //Register each fragment in the buckets it may reach
+  double slope = tan(tolAngle*M_PI/360.0);
+  int reach = tolOffset + (int) ceil(slope*tolDistGr);
+  vector<pair<pair<int, int>, int> > entries; //bucket and start of the fragments, rank in sorted order
+  entries.reserve(2*n);
+  for(int i=0; i<n; i++) {
+    int b1 = (int) floor((std::min(startAcross[i], endAcross[i]) - reach)/(double)bucketSize);
+    int b2 = (int) floor((std::max(startAcross[i], endAcross[i]) + reach)/(double)bucketSize);
+    for(int b=b1; b<=b2; b++)
+      entries.push_back(make_pair(make_pair(b, start[i]), i));
+  }
+  std::sort(entries.begin(), entries.end());
+  
+  //Join the fragments of each bucket starting close to the support line of a previous one
+  vector<int> root(n);
+  std::iota(root.begin(), root.end(), 0);
+  for(int k=0; k<entries.size(); k++) {
+    int i = entries[k].second;
+    int len = end[i] - start[i];
+    for(int m=k+1; m<entries.size() && entries[m].first.first == entries[k].first.first; m++) {
+      int j = entries[m].second;
+      int gap = start[j] - end[i];
+      if(gap >= tolDistGr)
+        break;
+      double c = endAcross[i]; //support line of fragment i at the start of fragment j
+      if(gap < 0 && len > 0)
+        c = startAcross[i] + (endAcross[i] - startAcross[i])*(start[j] - start[i])/(double)len;
+      if(fabs(startAcross[j] - c) <= tolOffset + slope*std::max(gap, 0)) {
+        int r1 = i, r2 = j;
+        while(root[r1] != r1) r1 = root[r1] = root[root[r1]];
+        while(root[r2] != r2) r2 = root[r2] = root[root[r2]];
+        root[std::max(r1,r2)] = std::min(r1,r2);
+      }
+    }
+  }
+  
+  //Extend each group from its first to its last end, in order of its first fragment
+  vector<int> groupId(n, -1), length;
+  for(int i=0; i<n; i++) {
+    int r = i;
+    while(root[r] != r) r = root[r];
+    if(groupId[r] < 0) {
+      groupId[r] = groups.size();
+      groups.push_back(seg[order[i]]);
+      length.push_back(0);
+    }
+    pair<Pt2i, Pt2i>& g = groups[groupId[r]];
+    if(start[i] < along(g.first))
+      g.first = seg[order[i]].first;
+    if(end[i] > along(g.second))
+      g.second = seg[order[i]].second;
+    length[groupId[r]] += abs(end[i] - start[i]);
+  }
+  int kept = 0;
+  for(int it=0; it<groups.size(); it++)
+    if(length[it] > tolLen)
+      groups[kept++] = groups[it];
+  groups.resize(kept);
+  return groups;
+}
+
 /**
  * @brief Recovery horizontal  segments
  * @param segH : vecgtor of horizontal  segment
  * @param tolAlign : tolerance angle
  * @param tolDistGr : tolerance distance for regrouping
  * @param tolLen : tolerance of segment length
- * @return bool
+ * @return vector of recovered horizontal segments
  */
 std::vector<std::pair<Pt2i, Pt2i> >
 HorizontalSegRecovery(const std::vector<std::pair<Pt2i, Pt2i> >& segH,
                       double tolAlign = 5,
                       int tolDistGr = 20,
                       int tolLen = 30) {
-  // Sort horizontal segments
-  std::vector<std::pair<Pt2i, Pt2i> > segHs = segH;
-  std::sort(std::begin(segHs), std::end(segHs),
-            [](std::pair<Pt2i, Pt2i> s1, std::pair<Pt2i, Pt2i> s2)
-            { return s1.first.y() < s2.first.y() || (s1.first.y() == s2.first.y() && s1.first.x() < s2.first.x()); });
-  
-  //Extend horizontal segments
-  std::vector<std::pair<Pt2i, Pt2i> > segHsE, segVsE;
-  std::vector<std::vector<int> > idSegHsE, idSegVsE;
-  int it1 = 0, it2 = 0;
-  Pt2i lp1, rp1, lp2, rp2, lp3, rp3;
-  int l = 0;
-  while (it1 < segHs.size()-1) {
-    std::vector<int> idSeg;
-    lp1 = segHs.at(it1).first;
-    rp1 = segHs.at(it1).second;
-    l = abs(rp1.x() - lp1.x());
-    lp3 = lp1;
-    rp3 = rp1;
-    it2 = it1 + 1;
-    lp2 = segHs.at(it2).first;
-    rp2 = segHs.at(it2).second;
-    idSeg.push_back(it1);
-    while (it2 < segHs.size()-1 && isHorizontalSegment(lp1, rp2, tolAlign/2.0) /* abs(lp1.y() - lp2.y()) < tolAlign */ ) {
-      if(lp3.x()>lp2.x())
-        lp3 = lp2;
-      if(rp3.x()<rp2.x())
-        rp3 = rp2;
-      l += abs(rp2.x() - lp2.x()) ;
-      idSeg.push_back(it2);
-      it2++;
-      lp2 = segHs.at(it2).first;
-      rp2 = segHs.at(it2).second;
-    }
-    segHsE.push_back(std::make_pair(lp3, rp3));
-    it1 = it2;
-    idSegHsE.push_back(idSeg);
-  }
-  if(it1 == segHs.size()-1) {
-    lp1 = segHs.at(it1).first;
-    rp1 = segHs.at(it1).second;
-    segHsE.push_back(std::make_pair(lp1, rp1));
-    idSegHsE.push_back(vector<int> (1,it1));
-  }
-  
-  // Regroupe horizontal segments
-  std::vector<std::pair<Pt2i, Pt2i> > segHsEg;
-  for(int it=0; it<idSegHsE.size(); it++) {
-    std::vector<int> idSeg = idSegHsE.at(it);
-    std::vector<std::pair<Pt2i, Pt2i> > segEx;
-    for(int it_bis=0; it_bis<idSeg.size(); it_bis++) {
-      Pt2i lp = segHs.at(idSeg.at(it_bis)).first;
-      Pt2i rp = segHs.at(idSeg.at(it_bis)).second;
-      segEx.push_back(make_pair(lp, rp));
-    }
-    std::sort(std::begin(segEx), std::end(segEx),
-              [](std::pair<Pt2i, Pt2i> s1, std::pair<Pt2i, Pt2i> s2) {return s1.first.x() < s2.first.x(); });
-    // Regroupe near horizontal segments
-    int it1=0, it2=0;
-    Pt2i lp1, rp1, lp2, rp2, lp3, rp3;
-    int l = 0;
-    while (it1 < segEx.size()-1) {
-      lp1 = segEx.at(it1).first;
-      rp1 = segEx.at(it1).second;
-      l = abs(rp1.x() - lp1.x());
-      lp3 = lp1;
-      rp3 = rp1;
-      it2 = it1 + 1;
-      lp2 = segEx.at(it2).first;
-      rp2 = segEx.at(it2).second;
-      while (it2 < segEx.size()-1 && abs(rp3.x() - lp2.x()) < tolDistGr) {
-        if(lp3.x()>lp2.x())
-          lp3 = lp2;
-        if(rp3.x()<rp2.x())
-          rp3 = rp2;
-        l += abs(rp2.x() - lp2.x()) ;
-        it2++;
-        lp2 = segEx.at(it2).first;
-        rp2 = segEx.at(it2).second;
-      }
-      //last segment
-      if(it2 == segEx.size()-1 && abs(rp3.x() - lp2.x()) < tolDistGr) {
-        if(lp3.x()>lp2.x())
-          lp3 = lp2;
-        if(rp3.x()<rp2.x())
-          rp3 = rp2;
-        l += abs(rp2.x() - lp2.x()) ;
-      }
-      if(l > tolLen)
-        segHsEg.push_back(std::make_pair(lp3, rp3));
-      it1 = it2;
-    }
-    if(it1 == segEx.size()-1) {
-      lp1 = segEx.at(it1).first;
-      rp1 = segEx.at(it1).second;
-      l = abs(rp1.x() - lp1.x());
-      if(l > tolLen)
-        segHsEg.push_back(std::make_pair(lp1, rp1));
-    }
-  }
-  return segHsEg;
+  return groupCollinearSegments(segH, false, tolAlign/2.0, tolDistGr, tolLen);
 }
 
 /**
@@ -220,120 +362,121 @@ HorizontalSegRecovery(const std::vector<std::pair<Pt2i, Pt2i> >& segH,
  * @param tolAlign : tolerance angle
  * @param tolDistGr : tolerance distance for regrouping
  * @param tolLen : tolerance of segment length
- * @return bool
+ * @return vector of recovered vertical segments
  */
 std::vector<std::pair<Pt2i, Pt2i> >
 VerticalSegRecovery(const std::vector<std::pair<Pt2i, Pt2i> >& segV,
                     double tolAlign = 5,
                     int tolDistGr = 20,
                     int tolLen = 30) {
-  // Sort vertial segments
-  std::vector<std::pair<Pt2i, Pt2i> > segVs = segV;
-  std::sort(std::begin(segVs), std::end(segVs),
-            [](std::pair<Pt2i, Pt2i> s1, std::pair<Pt2i, Pt2i> s2) //{return s1.first.x() < s2.first.x(); });
-            { return s1.first.x() < s2.first.x() || (s1.first.x() == s2.first.x() && s1.first.y() < s2.first.y()); });
-  //Extend vertial segments
-  std::vector<std::pair<Pt2i, Pt2i> > segVsE;
-  std::vector<std::vector<int> > idSegVsE;
-  int it1 = 0, it2 = 0;
-  Pt2i lp1, rp1, lp2, rp2, lp3, rp3;
-  int l = 0;
-  while (it1 < segVs.size()-1) {
-    std::vector<int> idSeg;
-    lp1 = segVs.at(it1).first;
-    rp1 = segVs.at(it1).second;
-    l = abs(rp1.y() - lp1.y());
-    lp3 = lp1;
-    rp3 = rp1;
-    it2 = it1 + 1;
-    lp2 = segVs.at(it2).first;
-    rp2 = segVs.at(it2).second;
-    idSeg.push_back(it1);
-    while (it2 < segVs.size()-1 && isVerticalSegment(lp1, rp2, tolAlign)
-    /*  abs(lp1.x() - lp2.x()) < tolAlign */) {
-      if(lp3.y()>lp2.y())
-        lp3 = lp2;
-      if(rp3.y()<rp2.y())
-        rp3 = rp2;
-      l += abs(rp2.y() - lp2.y());
-      idSeg.push_back(it2);
-      it2++;
-      lp2 = segVs.at(it2).first;
-      rp2 = segVs.at(it2).second;
-    }
-    segVsE.push_back(std::make_pair(lp3, rp3));
-    it1 = it2;
-    idSegVsE.push_back(idSeg);
-  }
-  if(it1 == segVs.size()-1) {
-    lp1 = segVs.at(it1).first;
-    rp1 = segVs.at(it1).second;
-    segVsE.push_back(std::make_pair(lp1, rp1));
-    idSegVsE.push_back(vector<int> (1, it1));
-  }
-  // Regroupe vertical segments
-  std::vector<std::pair<Pt2i, Pt2i> > segVsEg;
-  for(int it=0; it<idSegVsE.size(); it++) {
-    std::vector<int> idSeg = idSegVsE.at(it);
-    std::vector<std::pair<Pt2i, Pt2i> > segEx;
-    for(int it_bis=0; it_bis<idSeg.size(); it_bis++) {
-      Pt2i lp = segVs.at(idSeg.at(it_bis)).first;
-      Pt2i rp = segVs.at(idSeg.at(it_bis)).second;
-      segEx.push_back(make_pair(lp, rp));
-    }
-    std::sort(std::begin(segEx), std::end(segEx),
-              [](std::pair<Pt2i, Pt2i> s1, std::pair<Pt2i, Pt2i> s2) {return s1.first.y() < s2.first.y(); });
-    // Regroupe near vertical segments
-    int it1=0, it2=0;
-    Pt2i lp1, rp1, lp2, rp2, lp3, rp3;
-    int l = 0;
-    while (it1 < segEx.size()-1) {
-      lp1 = segEx.at(it1).first;
-      rp1 = segEx.at(it1).second;
-      l = abs(rp1.y() - lp1.y());
-      lp3 = lp1;
-      rp3 = rp1;
-      it2 = it1 + 1;
-      lp2 = segEx.at(it2).first;
-      rp2 = segEx.at(it2).second;
-      while (it2 < segEx.size()-1 && abs(rp3.y() - lp2.y()) < tolDistGr) {
-        if(lp3.y()>lp2.y())
-          lp3 = lp2;
-        if(rp3.y()<rp2.y())
-          rp3 = rp2;
-        l += abs(rp2.y() - lp2.y()) ;
-        it2++;
-        lp2 = segEx.at(it2).first;
-        rp2 = segEx.at(it2).second;
-      }
-      //last segment
-      if(it2 == segEx.size()-1 && abs(rp3.y() - lp2.y()) < tolDistGr) {
-        if(lp3.y()>lp2.y())
-          lp3 = lp2;
-        if(rp3.y()<rp2.y())
-          rp3 = rp2;
-        l += abs(rp2.y() - lp2.y()) ;
-      }
-      if(l > tolLen) {
-        segVsEg.push_back(std::make_pair(lp3, rp3));
-      }
-      it1 = it2;
-    }
-    if(it1 == segEx.size()-1) {
-      lp1 = segEx.at(it1).first;
-      rp1 = segEx.at(it1).second;
-      l = abs(rp1.y() - lp1.y());
-      if(l > tolLen) {
-        segVsEg.push_back(std::make_pair(lp1, rp1));
-      }
+  return groupCollinearSegments(segV, true, tolAlign, tolDistGr, tolLen);
+}
+
+/**
+ * @brief Prefix counts of the positions of a band passing the intensity profile test
+ * of text suppression, over the part of the band already covered by tested segments
+ */
+struct ProfileBand {
+  int start = 0; //first covered position
+  std::vector<int> counts; //counts of passed positions before each covered position (empty if none)
+};
+
+/**
+ * @brief Intensity profile tests of the bands of an image holding segments
+ * Each position is tested once per page, so that testing a segment lying on the
+ * covered part of a band only takes the difference of two prefix counts.
+ */
+struct ProfileCounts {
+  std::vector<ProfileBand> rows; //bands centered on each row (horizontal segments)
+  std::vector<ProfileBand> cols; //bands centered on each column (vertical segments)
+};
+
+/**
+ * @brief Verify the intensity profile test at a position of a band
+ * A column (row) of the band passes the test if one of its extremities is brighter than
+ * threshPic and differs by more than threshVal from a pixel of the column (row).
+ * @param grayImg : input gray image
+ * @param center : center row (column) of the band, lying at least w/2 pixels inside the image
+ * @param vertical : true for a vertical band, whose rows are tested
+ * @param pos : tested column (row)
+ * @param w : profile segment size
+ * @param threshPic : peak intensity at extremity
+ * @param threshVal : tolerance of intensity difference
+ * @return bool
+ */
+bool
+isProfilePeak(const Mat& grayImg,
+              int center,
+              bool vertical,
+              int pos,
+              int w = 7,
+              int threshPic = 200,
+              int threshVal = 100) {
+  int first = center - w/2;
+  int low = 255, high = 0, top = 0, bottom = 0;
+  for(int l=0; l<w; l++) {
+    int val = vertical ? grayImg.ptr<uchar>(pos)[first+l] : grayImg.ptr<uchar>(first+l)[pos];
+    low = std::min(low, val);
+    high = std::max(high, val);
+    if(l == 0)
+      top = val;
+    bottom = val;
+  }
+  if(top <= threshPic && bottom <= threshPic)
+    return false;
+  return top - low > threshVal || high - top > threshVal || bottom - low > threshVal || high - bottom > threshVal;
+}
+
+/**
+ * @brief Count the positions of a band passing the intensity profile test
+ * The covered part of the band is first extended to the counted interval, or moved
+ * to it when it lies farther than the interval length.
+ * @param grayImg : input gray image
+ * @param band : prefix counts of the band
+ * @param center : center row (column) of the band, lying at least w/2 pixels inside the image
+ * @param vertical : true for a vertical band, whose rows are tested
+ * @param from, to : counted interval of columns (rows), to excluded
+ * @param w : profile segment size
+ * @param threshPic : peak intensity at extremity
+ * @param threshVal : tolerance of intensity difference
+ * @return count of passed positions
+ */
+int
+countProfilePeaks(const Mat& grayImg,
+                  ProfileBand& band,
+                  int center,
+                  bool vertical,
+                  int from,
+                  int to,
+                  int w = 7,
+                  int threshPic = 200,
+                  int threshVal = 100) {
+  int end = band.start + (int) band.counts.size() - 1;
+  //A covered part far from the interval is dropped rather than joined to it
+  if(! band.counts.empty() && (from - end > to - from || band.start - to > to - from))
+    band.counts.clear();
+  if(band.counts.empty() || from < band.start || to > end) {
+    int start = band.counts.empty() ? from : std::min(from, band.start);
+    int stop = band.counts.empty() ? to : std::max(to, end);
+    std::vector<int> counts(stop - start + 1, 0);
+    for(int i=start; i<stop; i++) {
+      bool peak;
+      if(!band.counts.empty() && i >= band.start && i < end)
+        peak = band.counts[i-band.start+1] > band.counts[i-band.start];
+      else
+        peak = isProfilePeak(grayImg, center, vertical, i, w, threshPic, threshVal);
+      counts[i-start+1] = counts[i-start] + (peak ? 1 : 0);
     }
+    band.start = start;
+    band.counts.swap(counts);
   }
-  return segVsEg;
+  return band.counts[to-band.start] - band.counts[from-band.start];
 }
 
 /**
  * @brief Filter a horizontal text segment by verifying intensity profil along a segment
  * @param grayImg : input gray image
+ * @param profiles : profile test counts of the image, completed on demand
  * @param p1, p2 : input segment
  * @param w : profile segment size
  * @param ratio : tolerance of intensity profile
@@ -343,46 +486,27 @@ VerticalSegRecovery(const std::vector<std::pair<Pt2i, Pt2i> >& segV,
  */
 bool
 isHoziontalSegTab(const Mat& grayImg,
+                  ProfileCounts& profiles,
                   Pt2i p1, Pt2i p2,
                   int w = 7,
                   double ratio = 0.75,
                   int threshPic = 200,
                   int threshVal = 100) {
-  int countProfil=0;
-  int x = p1.x();
-  int y = p1.y() - w/2;
   int width = abs(p2.x() - p1.x());
-  int height = w;
-  //Create the rectangle
-  cv::Rect roi(x, y, width, height);
-  //Create the cv::Mat with the ROI you need, where "image" is the cv::Mat you want to extract the ROI from
-  cv::Mat image_roi = grayImg(roi);
-  //Count density (hight / low intensities) of roi
-  int highInt = 0, lowInt = 0;
-  uchar color;
-  countProfil = 0;
-  for (int c = 0; c < width; c++) {
-    std::vector<int> intensity;
-    for (int l = 0; l < height; l++) {
-      color = image_roi.at<uchar>(Point(c, l));
-      intensity.push_back(int(color));
-    }
-    size_t pic1=0, pic2=intensity.size()-1;
-    if(intensity[pic1]>threshPic || intensity[pic2]>threshPic) {
-      for(size_t l=pic1; l<=pic2; l++) {
-        if(abs(intensity[pic1]-intensity.at(l))>threshVal || abs(intensity[pic2]-intensity.at(l))>threshVal) {
-          countProfil++;
-          break;
-        }
-      }
-    }
-  }
+  int x1 = std::max(p1.x(), 0);
+  int x2 = std::min(p1.x() + width, grayImg.cols);
+  if(w < 1 || p1.y() - w/2 < 0 || p1.y() - w/2 + w > grayImg.rows || x1 >= x2)
+    return false;
+  if(profiles.rows.empty())
+    profiles.rows.resize(grayImg.rows);
+  int countProfil = countProfilePeaks(grayImg, profiles.rows[p1.y()], p1.y(), false, x1, x2, w, threshPic, threshVal);
   return countProfil>ratio*width;
 }
 
 /**
  * @brief Filter a veritcal text segment by verifying intensity profil along a segment
  * @param grayImg : input gray image
+ * @param profiles : profile test counts of the image, completed on demand
  * @param p1, p2 : input segment
  * @param w : profile segment size
  * @param ratio : tolerance of intensity profile
@@ -392,40 +516,20 @@ isHoziontalSegTab(const Mat& grayImg,
  */
 bool
 isVerticalSegTab(const Mat& grayImg,
+                 ProfileCounts& profiles,
                  Pt2i p1, Pt2i p2,
                  int w = 7,
                  double ratio = 0.75,
                  int threshPic = 200,
                  int threshVal = 100) {
-  int countProfil=0;
-  int x = p1.x() - w/2;
-  int y = p1.y();
-  int width = w;
   int height = abs(p2.y() - p1.y());
-  //Create the rectangle
-  cv::Rect roi(x, y, width, height);
-  //Create the cv::Mat with the ROI you need, where "image" is the cv::Mat you want to extract the ROI from
-  cv::Mat image_roi = grayImg(roi);
-  //Count density (hight / low intensities) of roi
-  int highInt = 0, lowInt = 0;
-  uchar color;
-  countProfil = 0;
-  for (int l = 0; l < height; l++) {
-    std::vector<int> intensity;
-    for (int c = 0; c < width; c++) {
-      color = image_roi.at<uchar>(Point(c, l));
-      intensity.push_back(int(color));
-    }
-    size_t pic1=0, pic2=intensity.size()-1;
-    if(intensity[pic1]>threshPic || intensity[pic2]>threshPic) {
-      for(size_t c=pic1; c<=pic2; c++) {
-        if(abs(intensity[pic1]-intensity.at(c))>threshVal || abs(intensity[pic2]-intensity.at(c))>threshVal) {
-          countProfil++;
-          break;
-        }
-      }
-    }
-  }
+  int y1 = std::max(p1.y(), 0);
+  int y2 = std::min(p1.y() + height, grayImg.rows);
+  if(w < 1 || p1.x() - w/2 < 0 || p1.x() - w/2 + w > grayImg.cols || y1 >= y2)
+    return false;
+  if(profiles.cols.empty())
+    profiles.cols.resize(grayImg.cols);
+  int countProfil = countProfilePeaks(grayImg, profiles.cols[p1.x()], p1.x(), true, y1, y2, w, threshPic, threshVal);
   return countProfil>ratio*height;
 }
 
@@ -492,33 +596,80 @@ getTableCells(const std::vector<std::pair<Pt2i, Pt2i> >& segH,
  * @param imgSize : input image size
  * @param cells : table cells
  * @param minSize : min size of connected component
+ * @param pageSize : size of the whole page when the image is a crop of it (default = image size)
  * @return vector of bounding boxes of tables
  */
 vector<pair<Pt2i, Pt2i> >
 getTables(Size imgSize,
           vector<pair<Pt2i, Pt2i> > cells,
-          int minSize = 100) {
-  Mat cellImage(imgSize,CV_8UC1, Scalar(0));
+          int minSize = 100,
+          Size pageSize = Size()) {
+  //Clip the filled cells to the image
+  vector<pair<Pt2i, Pt2i> > rects;
   for(int it=0; it<cells.size(); it++) {
     Pt2i p1 = cells.at(it).first;
     Pt2i p2 = cells.at(it).second;
-    rectangle(cellImage, Point(p1.x(), p1.y()), Point(p2.x(), p2.y()), Scalar(255),-1);
+    int x1 = std::max(std::min(p1.x(), p2.x()), 0);
+    int y1 = std::max(std::min(p1.y(), p2.y()), 0);
+    int x2 = std::min(std::max(p1.x(), p2.x()), imgSize.width-1);
+    int y2 = std::min(std::max(p1.y(), p2.y()), imgSize.height-1);
+    if(x1<=x2 && y1<=y2)
+      rects.push_back(make_pair(Pt2i(x1,y1), Pt2i(x2,y2)));
+  }
+  
+  //Compute 4-connected components of the cells (union-find on cells sorted by left side)
+  vector<int> order(rects.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&rects](int i, int j) {
+    return rects.at(i).first.x() < rects.at(j).first.x();
+  });
+  vector<int> root(rects.size());
+  std::iota(root.begin(), root.end(), 0);
+  for(int i=0; i<order.size(); i++) {
+    const pair<Pt2i, Pt2i>& a = rects.at(order.at(i));
+    for(int j=i+1; j<order.size(); j++) {
+      const pair<Pt2i, Pt2i>& b = rects.at(order.at(j));
+      if(b.first.x() > a.second.x()+1)
+        break;
+      bool xOverlap = b.first.x() <= a.second.x();
+      bool yOverlap = std::max(a.first.y(), b.first.y()) <= std::min(a.second.y(), b.second.y());
+      bool yTouch = std::max(a.first.y(), b.first.y()) <= std::min(a.second.y(), b.second.y())+1;
+      if((xOverlap && yTouch) || yOverlap) { //yOverlap implies x touching here
+        int ra = order.at(i), rb = order.at(j);
+        while(root.at(ra) != ra) ra = root.at(ra);
+        while(root.at(rb) != rb) rb = root.at(rb);
+        root.at(std::max(ra,rb)) = std::min(ra,rb);
+      }
+    }
   }
   
-  //Compute connected components
-  Mat labelImage;
-  Mat stats;
-  Mat centroids;
-  int nLabels = connectedComponentsWithStats (cellImage, labelImage, stats, centroids, 4);
   //Get bounding box
+  vector<pair<Pt2i, Pt2i> > comps;
+  vector<int> compId(rects.size(), -1);
+  for(int i=0; i<rects.size(); i++) {
+    int r = i;
+    while(root.at(r) != r) r = root.at(r);
+    if(compId.at(r) < 0) {
+      compId.at(r) = comps.size();
+      comps.push_back(rects.at(i));
+    }
+    pair<Pt2i, Pt2i>& c = comps.at(compId.at(r));
+    c.first.set(std::min(c.first.x(), rects.at(i).first.x()), std::min(c.first.y(), rects.at(i).first.y()));
+    c.second.set(std::max(c.second.x(), rects.at(i).second.x()), std::max(c.second.y(), rects.at(i).second.y()));
+  }
+  std::sort(comps.begin(), comps.end(), [](const pair<Pt2i, Pt2i>& a, const pair<Pt2i, Pt2i>& b) {
+    return a.first.y() < b.first.y() || (a.first.y() == b.first.y() && a.first.x() < b.first.x());
+  });
   vector<pair<Pt2i, Pt2i> > boxes;
-  int minWidth=imgSize.width/minSize;
-  int minHeight=imgSize.height/minSize;
-  for(int i=1; i<stats.rows; i++) { //label  0 is the background
-    int x = stats.at<int>(Point(0, i));
-    int y = stats.at<int>(Point(1, i));
-    int w = stats.at<int>(Point(2, i));
-    int h = stats.at<int>(Point(3, i));
+  if(pageSize.area() == 0)
+    pageSize = imgSize;
+  int minWidth=pageSize.width/minSize;
+  int minHeight=pageSize.height/minSize;
+  for(int i=0; i<comps.size(); i++) {
+    int x = comps.at(i).first.x();
+    int y = comps.at(i).first.y();
+    int w = comps.at(i).second.x() - x + 1;
+    int h = comps.at(i).second.y() - y + 1;
     Pt2i p1(x,y);
     Pt2i p2(x+w,y+h);
     if(w>minWidth+1 && h>minHeight+1)
@@ -527,60 +678,464 @@ getTables(Size imgSize,
   return boxes;
 }
 
+/**
+ * @brief Measures of a page taken in a single pass over its rows
+ */
+struct PageSurvey {
+  bool blank = true; //no row or column holds enough ink
+  Rect inkBox; //bounding box of the ink extended by the margin, clipped to the page
+  int strokeWidth = 0; //most frequent length of the dark runs, 0 if no ink is found
+  int longestH = 0, longestV = 0; //longest horizontal and vertical dark runs (rulings)
+};
 
-int main(int argc, char *argv[]) {
-  
-  // parse command line using CLI ----------------------------------------------
-  CLI::App app;
-  string imgFileName, resFilename{"result.png"};
+/**
+ * @brief Survey a page: ink bounding box, stroke width and rulings, reading its rows once
+ * Rows and columns holding less than minInk ink pixels (scanning noise) are ignored by the ink box.
+ * The ink threshold of the box is the one of the rulings, so that thin grey rulings are kept in the box.
+ * The stroke width is estimated from the runs of sampled rows and columns, runs on sampled columns
+ * are followed row by row. Light gaps up to maxGap pixels do not stop a ruling, so that broken
+ * rulings are measured as a whole.
+ * @param rows : gray level row source, read to its end
+ * @param survey : output measures of the page
+ * @param strokes : estimate the stroke width
+ * @param rulings : measure the longest rulings
+ * @param margin : extension of the ink bounding box on each side
+ * @param threshInk : intensity under which a pixel belongs to the ink of the box and of the rulings
+ * @param threshStroke : intensity under which a pixel belongs to the strokes
+ * @param minInk : min count of ink pixels of a row or column of the box
+ * @param sampling : distance between sampled rows (columns) of the stroke width estimation
+ * @param maxRun : runs longer than this (rulings, dark areas) are ignored by the stroke width estimation
+ * @param maxGap : longest light gap inside a ruling
+ */
+void
+surveyPage(RowSource& rows,
+           PageSurvey& survey,
+           bool strokes = true,
+           bool rulings = true,
+           int margin = 16,
+           int threshInk = 160,
+           int threshStroke = 128,
+           int minInk = 2,
+           int sampling = 8,
+           int maxRun = 64,
+           int maxGap = 2) {
+  int width = rows.getWidth();
+  int height = rows.getHeight();
+  survey = PageSurvey();
+  std::vector<uchar> row(width);
+  std::vector<int> colInk(width, 0);
+  std::vector<int> hist(maxRun, 0);
+  std::vector<int> strokeRuns(strokes ? (width + sampling - 1) / sampling : 0, 0);
+  std::vector<int> colRuns(rulings ? width : 0, 0), colGaps(rulings ? width : 0, 0);
+  int ymin = height, ymax = -1;
+  for (int y = 0; rows.nextRow(&row[0]); y++) {
+    int rowInk = 0, run = 0, gap = 0;
+    for (int x = 0; x < width; x++) {
+      bool ink = (row[x] < threshInk);
+      if (ink) {
+        colInk[x]++;
+        rowInk++;
+      }
+      if (!rulings)
+        continue;
+      //Horizontal rulings
+      if (ink) {
+        run += gap + 1;
+        gap = 0;
+        survey.longestH = std::max(survey.longestH, run);
+      }
+      else if (run > 0 && ++gap > maxGap)
+        run = gap = 0;
+      //Vertical rulings
+      if (ink) {
+        colRuns[x] += colGaps[x] + 1;
+        colGaps[x] = 0;
+        survey.longestV = std::max(survey.longestV, colRuns[x]);
+      }
+      else if (colRuns[x] > 0 && ++colGaps[x] > maxGap)
+        colRuns[x] = colGaps[x] = 0;
+    }
+    if (rowInk >= minInk) {
+      ymin = std::min(ymin, y);
+      ymax = y;
+    }
+    if (!strokes)
+      continue;
+    //Horizontal stroke runs on sampled rows
+    if (y % sampling == 0) {
+      run = 0;
+      for (int x = 0; x < width; x++) {
+        if (row[x] < threshStroke)
+          run++;
+        else {
+          if (run > 0 && run < maxRun)
+            hist[run]++;
+          run = 0;
+        }
+      }
+    }
+    //Vertical stroke runs on sampled columns
+    for (int c = 0; c < strokeRuns.size(); c++) {
+      if (row[c*sampling] < threshStroke)
+        strokeRuns[c]++;
+      else {
+        if (strokeRuns[c] > 0 && strokeRuns[c] < maxRun)
+          hist[strokeRuns[c]]++;
+        strokeRuns[c] = 0;
+      }
+    }
+  }
+  for (int l = 1; l < maxRun; l++)
+    if (hist[l] > hist[survey.strokeWidth])
+      survey.strokeWidth = l;
+  int xmin = width, xmax = -1;
+  for (int x = 0; x < width; x++)
+    if (colInk[x] >= minInk) {
+      xmin = std::min(xmin, x);
+      xmax = x;
+    }
+  if (xmax < 0 || ymax < 0)
+    return;
+  xmin = std::max(xmin - margin, 0);
+  ymin = std::max(ymin - margin, 0);
+  xmax = std::min(xmax + margin, width - 1);
+  ymax = std::min(ymax + margin, height - 1);
+  survey.inkBox = Rect(xmin, ymin, xmax - xmin + 1, ymax - ymin + 1);
+  survey.blank = false;
+}
+
+/**
+ * @brief Pre-screen a page: a ruled table needs both horizontal and vertical rulings
+ * @param survey : measures of the page, with its rulings
+ * @param minLength : min length of the rulings in input image pixels
+ * @return false if the page has no long enough dark run in one of the directions
+ */
+bool
+mayContainTables(const PageSurvey& survey,
+                 int minLength) {
+  return survey.longestH >= minLength && survey.longestV >= minLength;
+}
+
+/**
+ * @brief Find the strokes crossing the long dark runs of a bilevel image
+ * Each horizontal (vertical) run is crossed by vertical (horizontal) strokes spaced by minLength
+ * pixels, so that the FBSD detector tracks the ruling from there even if a crossing text or
+ * ruling spoils one of the seeds. Light gaps up to maxGap pixels do not stop a run.
+ * The seeds of the parallel runs of a thick ruling are already masked by the first detected segment.
+ * @param grayImg : input gray image
+ * @param minLength : min length of the runs (at least 1)
+ * @param halfWidth : half length of the strokes
+ * @param threshInk : intensity under which a pixel belongs to the ink
+ * @param maxGap : longest light gap inside a run
+ * @return vector of strokes (end points), crossing horizontal runs first
+ */
+std::vector<std::pair<Pt2i, Pt2i> >
+findRulingStrokes(const Mat& grayImg,
+                  int minLength,
+                  int halfWidth = 8,
+                  int threshInk = 128,
+                  int maxGap = 2) {
+  minLength = std::max(1, minLength);
+  std::vector<std::pair<Pt2i, Pt2i> > hStrokes, vStrokes;
+  std::vector<int> colStart(grayImg.cols, -1), colLast(grayImg.cols, -1);
+  for (int y = 0; y <= grayImg.rows; y++) {
+    const uchar *row = (y < grayImg.rows ? grayImg.ptr<uchar>(y) : NULL);
+    int start = -1, last = -1;
+    for (int x = 0; x <= grayImg.cols; x++) {
+      bool ink = (row != NULL && x < grayImg.cols && row[x] < threshInk);
+      //Horizontal runs
+      if (ink) {
+        if (start < 0)
+          start = x;
+        last = x;
+      }
+      else if (start >= 0 && (x - last > maxGap || x == grayImg.cols)) {
+        int len = last - start + 1;
+        if (len >= minLength)
+          for (int xm = start + (len % minLength + minLength) / 2; xm <= last; xm += minLength)
+            hStrokes.push_back(std::make_pair(Pt2i(xm, y - halfWidth), Pt2i(xm, y + halfWidth)));
+        start = -1;
+      }
+      if (x == grayImg.cols)
+        break;
+      //Vertical runs
+      if (ink) {
+        if (colStart[x] < 0)
+          colStart[x] = y;
+        colLast[x] = y;
+      }
+      else if (colStart[x] >= 0 && (y - colLast[x] > maxGap || row == NULL)) {
+        int len = colLast[x] - colStart[x] + 1;
+        if (len >= minLength)
+          for (int ym = colStart[x] + (len % minLength + minLength) / 2; ym <= colLast[x]; ym += minLength)
+            vStrokes.push_back(std::make_pair(Pt2i(x - halfWidth, ym), Pt2i(x + halfWidth, ym)));
+        colStart[x] = -1;
+      }
+    }
+  }
+  hStrokes.insert(hStrokes.end(), vStrokes.begin(), vStrokes.end());
+  return hStrokes;
+}
+
+/**
+ * @brief Extend a crop so that its top-left corner lies on the downsampling grid of the page
+ * Working pixels of the crop then average the same input blocks as those of the whole page.
+ * @param box : crop in input image pixels, extended in place
+ * @param down : downsampling factor applied to the input image
+ */
+void
+alignCropToGrid(Rect& box,
+                int down) {
+  int x = (box.x / down) * down;
+  int y = (box.y / down) * down;
+  box.width += box.x - x;
+  box.height += box.y - y;
+  box.x = x;
+  box.y = y;
+}
+
+/**
+ * @brief Map boxes (cells, tables) from working resolution back to input image coordinates
+ * The mapped box covers all the input pixels of its corner working pixels.
+ * @param boxes : boxes at working resolution (top-left, bottom-right)
+ * @param up : upsampling factor applied to the input image
+ * @param down : downsampling factor applied to the input image
+ * @param origin : top-left corner of the processed crop in input image pixels
+ * @return boxes in input image coordinates
+ */
+std::vector<std::pair<Pt2i, Pt2i> >
+mapBoxesToInput(const std::vector<std::pair<Pt2i, Pt2i> >& boxes,
+                int up = 1,
+                int down = 1,
+                Point origin = Point()) {
+  std::vector<std::pair<Pt2i, Pt2i> > res;
+  res.reserve(boxes.size());
+  for(size_t it=0; it<boxes.size(); it++) {
+    Pt2i p1 = boxes.at(it).first;
+    Pt2i p2 = boxes.at(it).second;
+    res.push_back(make_pair(Pt2i(origin.x + (p1.x()*down)/up, origin.y + (p1.y()*down)/up),
+                            Pt2i(origin.x + (p2.x()*down + down - 1)/up, origin.y + (p2.y()*down + down - 1)/up)));
+  }
+  return res;
+}
+
+
+/**
+ * @brief Blend an image row in place with white inside boxes and with black elsewhere
+ * @param row : input and output 8-bit row
+ * @param y : row index
+ * @param cols : row width
+ * @param channels : count of bytes per pixel
+ * @param boxes : boxes given by top-left and bottom-right corners (included)
+ * @param alpha : weight of the image in the blend
+ * @param inside : buffer of cols flags
+ */
+void
+highlightRow(uchar* row,
+             int y,
+             int cols,
+             int channels,
+             const std::vector<std::pair<Pt2i, Pt2i> >& boxes,
+             double alpha,
+             std::vector<bool>& inside) {
+  std::fill(inside.begin(), inside.end(), false);
+  for(int it=0; it<boxes.size(); it++) {
+    Pt2i p1 = boxes.at(it).first;
+    Pt2i p2 = boxes.at(it).second;
+    if(y < std::min(p1.y(), p2.y()) || y > std::max(p1.y(), p2.y()))
+      continue;
+    int x2 = std::min(std::max(p1.x(), p2.x()), cols-1);
+    for(int x=std::max(std::min(p1.x(), p2.x()), 0); x<=x2; x++)
+      inside[x] = true;
+  }
+  for(int x=0; x<cols; x++) {
+    double white = inside[x] ? (1.0 - alpha)*255 : 0.0;
+    for(int c=0; c<channels; c++, row++)
+      *row = saturate_cast<uchar>(alpha*(*row) + white);
+  }
+}
+
+/**
+ * @brief Blend an image in place with white inside boxes and with black elsewhere
+ * @param img : input and output 8-bit image
+ * @param boxes : boxes given by top-left and bottom-right corners (included)
+ * @param alpha : weight of the image in the blend
+ */
+void
+highlightBoxes(Mat& img,
+               const std::vector<std::pair<Pt2i, Pt2i> >& boxes,
+               double alpha = 0.5) {
+  std::vector<bool> inside(img.cols);
+  for(int y=0; y<img.rows; y++)
+    highlightRow(img.ptr<uchar>(y), y, img.cols, img.channels(), boxes, alpha, inside);
+}
+
+/**
+ * @brief Parameters of the table extraction
+ * The window, distance and length tolerances are given in working resolution pixels, where
+ * the strokes are about stroke pixels wide, so that they hold whatever the scan resolution.
+ */
+struct ExtractionParams {
   int win = 7;
   double tolAlign = 5;
   int tolDistGr = 20;
   int tolLen = 30;
   double ratio = 0.75;
-  
-  app.add_option("--input,-i,1", imgFileName, "Input filename.");
-  app.add_option("--output,-o,2", resFilename, "Output filename (default = result.png)", true);
-  app.add_option("--window,-w", win, "Window size of intensity analysis (default = 7) ", true);
-  app.add_option("--angle,-a", tolAlign, "Angle tolerance for horizontal and vertical segments (default = 5 degree)", true);
-  app.add_option("--distance,-d", tolDistGr, "Max distance to regroupe the segments (default = 20)", true);
-  app.add_option("--len,-l", tolLen, "Min length of segments (default = 30)", true);
-  app.add_option("--ratio,-r", ratio, "Ratio for eliminating text segments (default = 0.75)", true);
-  
-  app.get_formatter()->column_width(40);
-  CLI11_PARSE(app, argc, argv);
-  // END parse command line using CLI ----------------------------------------------
-  
-  // Load image
-  Mat img = imread(imgFileName, IMREAD_COLOR);
-  int width = img.cols;
-  int height = img.rows;
-  if (width == 0 || height == 0) {
-    cerr << "Couldn't open the " << imgFileName << " image file." << endl;
-    exit (EXIT_FAILURE);
+  int stroke = 4;
+  bool axisOnly = false;
+  std::vector<int> roi;
+  int deadline = 0;
+  int tileBudget = 0;
+  bool failureCache = false;
+  bool seedFilter = false;
+  bool adaptiveSweep = false;
+  int prescreen = 0;
+  bool fullPage = false;
+  bool bilevel = false;
+  TaskPool* pool = NULL; //shared pool of the intra-page tasks, NULL to run them in sequence
+  bool saveSegments = false;
+  bool replay = false;
+};
+
+/**
+ * @brief Select the working resolution: thick strokes of high resolution scans are
+ * reduced to the reference stroke width, small images are upsampled
+ * @param strokeWidth : estimated stroke width of the input image
+ * @param width, height : input image size
+ * @param stroke : reference stroke width (0 to keep the input resolution)
+ * @param up : output upsampling factor
+ * @param down : output downsampling factor
+ */
+void
+selectWorkingScale(int strokeWidth,
+                   int width,
+                   int height,
+                   int stroke,
+                   int& up,
+                   int& down) {
+  down = 1;
+  if (stroke > 0)
+    down = std::max(1, strokeWidth / stroke);
+  up = (down == 1 && std::max(width,height) <= 800) ? 2 : 1;
+}
+
+/**
+ * @brief Map regions of interest from input image to working resolution
+ * @param roi : regions given as x y w h in input image pixels
+ * @param up : upsampling factor applied to the input image
+ * @param down : downsampling factor applied to the input image
+ * @param origin : top-left corner of the processed crop in input image pixels
+ * @return vector of boxes (top-left and bottom-right corners)
+ */
+std::vector<std::pair<Pt2i, Pt2i> >
+mapRoiToWorking(const std::vector<int>& roi,
+                int up = 1,
+                int down = 1,
+                Point origin = Point()) {
+  std::vector<std::pair<Pt2i, Pt2i> > areas;
+  for(int it=0; it+3<roi.size(); it+=4) {
+    if(roi[it+2] <= 0 || roi[it+3] <= 0)
+      continue;
+    int x = roi[it] - origin.x;
+    int y = roi[it+1] - origin.y;
+    areas.push_back(std::make_pair(Pt2i((x*up)/down, (y*up)/down),
+                                   Pt2i(((x+roi[it+2])*up - 1)/down,
+                                        ((y+roi[it+3])*up - 1)/down)));
   }
-  int scale = std::max(width,height) > 800 ? 1 : 2;
-  resize(img, img, Size(scale*width,scale*height),INTER_LINEAR);
-  width = scale*width;
-  height = scale*height;
-  Mat grayImg;
-  cvtColor(img, grayImg, COLOR_BGR2GRAY);
-  
-  // Step 1: Line segment detection using FBSD detector
-  std::vector<std::pair<Pt2i, Pt2i> > seg = FBSDDetector(grayImg);
-  
+  return areas;
+}
+
+/**
+ * @brief Run independent tasks on the shared pool, or in sequence without pool
+ * @param pool : shared task pool (may be NULL)
+ * @param tasks : tasks to run
+ */
+void
+runTasks(TaskPool* pool,
+         const std::vector<std::function<void ()> >& tasks) {
+  if(pool != NULL)
+    pool->run(tasks);
+  else
+    for(int it=0; it<tasks.size(); it++)
+      tasks.at(it)();
+}
+
+/**
+ * @brief Suppress the segments belonging to text (step 4)
+ * The segments are tested by independent tasks, each one in charge of whole bands,
+ * so that the profile counts of a band are never completed by two tasks at once.
+ * @param grayImg : gray image at working resolution
+ * @param seg : horizontal (vertical) segments
+ * @param vertical : true for vertical segments
+ * @param profiles : profile test counts of the image, completed on demand
+ * @param params : extraction parameters
+ * @param grain : min count of segments tested by a task
+ * @return vector of kept segments, in input order
+ */
+std::vector<std::pair<Pt2i, Pt2i> >
+suppressTextSegments(const Mat& grayImg,
+                     const std::vector<std::pair<Pt2i, Pt2i> >& seg,
+                     bool vertical,
+                     ProfileCounts& profiles,
+                     const ExtractionParams& params,
+                     int grain = 32) {
+  if(vertical)
+    profiles.cols.resize(grayImg.cols);
+  else
+    profiles.rows.resize(grayImg.rows);
+  auto band = [&seg, vertical](int it) { return vertical ? seg.at(it).first.x() : seg.at(it).first.y(); };
+  vector<int> order(seg.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&band](int i, int j) { return band(i) < band(j); });
+  vector<char> kept(seg.size(), 0);
+  std::vector<std::function<void ()> > tasks;
+  for(int first=0; first<order.size(); ) {
+    int last = std::min(first + grain, (int) order.size());
+    while(last < order.size() && band(order.at(last)) == band(order.at(last-1)))
+      last++;
+    tasks.push_back([&, first, last]() {
+      for(int it=first; it<last; it++) {
+        Pt2i lp = seg.at(order.at(it)).first;
+        Pt2i rp = seg.at(order.at(it)).second;
+        kept.at(order.at(it)) = vertical ? isVerticalSegTab(grayImg, profiles, lp, rp, params.win, params.ratio)
+                                         : isHoziontalSegTab(grayImg, profiles, lp, rp, params.win, params.ratio);
+      }
+    });
+    first = last;
+  }
+  runTasks(params.pool, tasks);
+  std::vector<std::pair<Pt2i, Pt2i> > res;
+  for(int it=0; it<seg.size(); it++)
+    if(kept.at(it))
+      res.push_back(seg.at(it));
+  return res;
+}
+
+/**
+ * @brief Extract the tables from detected line segments (steps 2 to 6)
+ * @param grayImg : gray image at working resolution
+ * @param seg : line segments detected in the gray image
+ * @param params : extraction parameters
+ * @param pageSize : size of the whole page at working resolution when the gray image is a crop of it
+ * @return vector of bounding boxes of tables (working resolution)
+ */
+vector<pair<Pt2i, Pt2i> >
+extractTables(const Mat& grayImg,
+              const std::vector<std::pair<Pt2i, Pt2i> >& seg,
+              const ExtractionParams& params,
+              Size pageSize = Size()) {
   //Step 2: Horizontal and vertical segment extraction
   std::vector<std::pair<Pt2i, Pt2i> > segH, segV;
   for(int it=0; it<seg.size(); it++) {
     Pt2i lp = seg.at(it).first;
     Pt2i rp = seg.at(it).second;
-    if(isHorizontalSegment(lp, rp, tolAlign)) {
+    if(isHorizontalSegment(lp, rp, params.tolAlign)) {
       if(lp.x()<rp.x()) //lp = left and rp = right
         segH.push_back(std::make_pair(lp, rp));
       else
         segH.push_back(std::make_pair(rp, lp));
     }
-    if(isVerticalSegment(lp, rp, tolAlign)) {
+    if(isVerticalSegment(lp, rp, params.tolAlign)) {
       if(lp.y()<rp.y()) //lp = down and rp = up
         segV.push_back(std::make_pair(lp, rp));
       else
@@ -588,45 +1143,824 @@ int main(int argc, char *argv[]) {
     }
   }
   
-  //Step 3: Line segment recovery
-  std::vector<std::pair<Pt2i, Pt2i> > segHsEg = HorizontalSegRecovery(segH,tolAlign,tolDistGr,tolLen);
-  std::vector<std::pair<Pt2i, Pt2i> > segVsEg = VerticalSegRecovery(segV,tolAlign,tolDistGr,tolLen);
-  
-  //Step 4: Suppression of segments belonging to text
+  //Steps 3 and 4: horizontal and vertical branches, independent up to step 5
   std::vector<std::pair<Pt2i, Pt2i> > segHsEgT, segVsEgT;
-  //Horizontal segments
-  for(int it=0; it<segHsEg.size(); it++) {
-    Pt2i lp = segHsEg.at(it).first;
-    Pt2i rp = segHsEg.at(it).second;
-    if(isHoziontalSegTab(grayImg, lp, rp, win, ratio))
-      segHsEgT.push_back(make_pair(lp, rp));
-  }
-  //Vertical segments
-  for(int it=0; it<segVsEg.size(); it++) {
-    Pt2i lp = segVsEg.at(it).first;
-    Pt2i rp = segVsEg.at(it).second;
-    if(isVerticalSegTab(grayImg, lp, rp, win, ratio))
-      segVsEgT.push_back(make_pair(lp, rp));
-  }
+  ProfileCounts profiles;
+  std::vector<std::function<void ()> > branches;
+  branches.push_back([&]() {
+    //Step 3: Line segment recovery
+    std::vector<std::pair<Pt2i, Pt2i> > segHsEg = HorizontalSegRecovery(segH,params.tolAlign,params.tolDistGr,params.tolLen);
+    //Step 4: Suppression of segments belonging to text
+    segHsEgT = suppressTextSegments(grayImg, segHsEg, false, profiles, params);
+  });
+  branches.push_back([&]() {
+    std::vector<std::pair<Pt2i, Pt2i> > segVsEg = VerticalSegRecovery(segV,params.tolAlign,params.tolDistGr,params.tolLen);
+    segVsEgT = suppressTextSegments(grayImg, segVsEg, true, profiles, params);
+  });
+  runTasks(params.pool, branches);
   
   //Step 5: Table cell extraction
   vector<pair<Pt2i, Pt2i> > cells = getTableCells(segHsEgT, segVsEgT);
   
   //Step 6: Table reconstruction
-  vector<pair<Pt2i, Pt2i> > tables = getTables(grayImg.size(), cells);
+  vector<pair<Pt2i, Pt2i> > tables = getTables(grayImg.size(), cells, 100, pageSize);
+  
+  return tables;
+}
+
+/**
+ * @brief Read gray level rows into a gray image, missing rows are set to 0
+ * @param rows : gray level rows, read to their end
+ * @param grayImg : output gray image
+ */
+void
+readGrayRows(RowSource& rows,
+             Mat& grayImg) {
+  grayImg.create(rows.getHeight(), rows.getWidth(), CV_8UC1);
+  bool reading = true;
+  for (int y = 0; y < grayImg.rows; y++) {
+    if (reading)
+      reading = rows.nextRow(grayImg.ptr<uchar>(y));
+    if (!reading)
+      std::fill(grayImg.ptr<uchar>(y), grayImg.ptr<uchar>(y) + grayImg.cols, 0);
+  }
+}
+
+/**
+ * @brief Detect line segments from gray level rows at working resolution (step 1)
+ * The rows are read once: the gradient map is computed while they are read, and
+ * they are kept in the gray image for the table extraction steps.
+ * Bilevel pages are seeded from their long dark runs, except when processed by tiles.
+ * @param rows : gray level rows at working resolution, read to their end
+ * @param params : extraction parameters
+ * @param areas : if not empty, detection is restricted to these boxes (working resolution)
+ * @param grayImg : output gray image at working resolution
+ * @param truncated : set to true when segment detection was stopped by the deadline
+ * @param counts : if not null, incremented with the work saved by the accelerations
+ * @return vector of pair of points
+ */
+std::vector<std::pair<Pt2i, Pt2i> >
+detectFromRows(RowSource& rows,
+               const ExtractionParams& params,
+               const std::vector<std::pair<Pt2i, Pt2i> >& areas,
+               Mat& grayImg,
+               bool& truncated,
+               DetectionCounts* counts = NULL) {
+  grayImg.create(rows.getHeight(), rows.getWidth(), CV_8UC1);
+  if (params.tileBudget > 0) {
+    // The gray image is held whole, only the gradient maps are built tile by tile
+    readGrayRows(rows, grayImg);
+    return FBSDDetector(grayImg, params.axisOnly ? params.tolAlign : 0, areas, params.deadline, &truncated, params.tileBudget, params.failureCache, params.seedFilter, params.adaptiveSweep, counts);
+  }
+  VMap gMap(rows, VMap::TYPE_SOBEL_5X5, grayImg.ptr<uchar>(0));
+  if (params.bilevel) {
+    // Rulings of bilevel pages are seeded from their long dark runs, inside the areas if any
+    std::vector<std::pair<Pt2i, Pt2i> > strokes, runStrokes = findRulingStrokes(grayImg, (2 * params.tolLen) / 3);
+    for (int it = 0; it < runStrokes.size(); it++) {
+      Pt2i pc((runStrokes[it].first.x() + runStrokes[it].second.x()) / 2,
+              (runStrokes[it].first.y() + runStrokes[it].second.y()) / 2);
+      bool inside = areas.empty();
+      for (int ia = 0; !inside && ia < areas.size(); ia++)
+        inside = (pc.x() >= areas[ia].first.x() && pc.x() <= areas[ia].second.x()
+                  && pc.y() >= areas[ia].first.y() && pc.y() <= areas[ia].second.y());
+      if (inside)
+        strokes.push_back(runStrokes[it]);
+    }
+    if (strokes.empty())
+      return std::vector<std::pair<Pt2i, Pt2i> >();
+    return FBSDDetector(&gMap, params.axisOnly ? params.tolAlign : 0, areas, params.deadline, &truncated, params.failureCache, params.seedFilter, params.adaptiveSweep, strokes, counts);
+  }
+  return FBSDDetector(&gMap, params.axisOnly ? params.tolAlign : 0, areas, params.deadline, &truncated, params.failureCache, params.seedFilter, params.adaptiveSweep, std::vector<std::pair<Pt2i, Pt2i> >(), counts, params.pool);
+}
+
+/**
+ * @brief Step 1 results of a page, saved to replay the table extraction (steps 2 to 6)
+ */
+struct DetectionRecord {
+  int width = 0, height = 0; //input page size
+  Rect content; //processed crop in input image pixels, aligned on the downsampling grid
+  int up = 1, down = 1; //working resolution
+  bool truncated = false, screenedOut = false, blank = false;
+  std::vector<int> settings; //step 1 settings of the detection (see detectionSettings)
+  std::vector<std::pair<Pt2i, Pt2i> > seg; //detected segments at working resolution
+};
+
+/**
+ * @brief Settings of the extraction parameters used by step 1 (crop, working resolution, segment detection)
+ * The angle tolerance is kept in thousandths of degree, and only for the axis window.
+ * The length tolerance is kept only for bilevel pages, which are seeded from runs of 2/3 of it.
+ * @param params : extraction parameters
+ * @return settings in the order of settingMismatch, followed by the regions of interest
+ */
+std::vector<int>
+detectionSettings(const ExtractionParams& params) {
+  std::vector<int> settings = {params.stroke, params.fullPage, params.prescreen,
+                               params.bilevel, params.bilevel ? params.tolLen : 0,
+                               params.axisOnly, params.axisOnly ? int(std::lround(params.tolAlign * 1000)) : 0,
+                               params.deadline, params.tileBudget,
+                               params.failureCache, params.seedFilter, params.adaptiveSweep};
+  settings.insert(settings.end(), params.roi.begin(), params.roi.end());
+  return settings;
+}
+
+/**
+ * @brief Find a step 1 setting of a detection record that differs from the extraction parameters
+ * Segments detected with other settings would not give the tables of a full extraction.
+ * @param record : detection record
+ * @param params : extraction parameters
+ * @return option name of the first differing setting, empty if the settings are the same
+ */
+string
+settingMismatch(const DetectionRecord& record,
+                const ExtractionParams& params) {
+  static const char* names[] = {"--stroke", "--full-page", "--prescreen", "--bilevel", "--len", "--axis-only",
+                                "--angle", "--deadline-ms", "--tile-mb", "--failure-cache", "--seed-filter",
+                                "--adaptive-sweep"};
+  std::vector<int> settings = detectionSettings(params);
+  for (int it = 0; it < settings.size() || it < record.settings.size(); it++)
+    if (it >= settings.size() || it >= record.settings.size() || settings[it] != record.settings[it])
+      return it < sizeof(names) / sizeof(names[0]) ? names[it] : "--roi";
+  return "";
+}
+
+/**
+ * @brief Filename without its extension
+ * @param name : filename
+ */
+string
+fileStem(const string& name) {
+  size_t dot = name.find_last_of('.');
+  size_t slash = name.find_last_of('/');
+  return (dot == string::npos || (slash != string::npos && dot < slash)) ? name : name.substr(0, dot);
+}
+
+/**
+ * @brief Name of the file holding the detection record of a page: the input name with a .seg extension
+ * @param input : input filename
+ */
+string
+recordName(const string& input) {
+  return fileStem(input) + ".seg";
+}
+
+/**
+ * @brief Write a detection record
+ * The file holds the "TXSG" tag and little-endian 32-bit integers: version (2), page width and
+ * height, crop x y w h, up and down factors, flags (truncated, screened out, blank), count
+ * of step 1 settings and the settings, count of segments and the end point coordinates
+ * of the segments.
+ * @param fileName : output filename
+ * @param record : detection record
+ * @return false on write error
+ */
+bool
+writeDetectionRecord(const string& fileName,
+                     const DetectionRecord& record) {
+  std::vector<int> fields = {2, record.width, record.height,
+                             record.content.x, record.content.y, record.content.width, record.content.height,
+                             record.up, record.down,
+                             (record.truncated ? 1 : 0) | (record.screenedOut ? 2 : 0) | (record.blank ? 4 : 0),
+                             int(record.settings.size())};
+  fields.insert(fields.end(), record.settings.begin(), record.settings.end());
+  fields.push_back(int(record.seg.size()));
+  for (int it = 0; it < record.seg.size(); it++) {
+    fields.push_back(record.seg[it].first.x());
+    fields.push_back(record.seg[it].first.y());
+    fields.push_back(record.seg[it].second.x());
+    fields.push_back(record.seg[it].second.y());
+  }
+  std::vector<char> bytes(4 + 4 * fields.size());
+  const char tag[] = "TXSG";
+  std::copy(tag, tag + 4, bytes.begin());
+  for (int it = 0; it < fields.size(); it++)
+    for (int b = 0; b < 4; b++)
+      bytes[4 + 4 * it + b] = char((unsigned(fields[it]) >> (8 * b)) & 0xff);
+  ofstream out(fileName.c_str(), ios::binary);
+  out.write(&bytes[0], bytes.size());
+  return bool(out);
+}
+
+/**
+ * @brief Read a detection record
+ * @param fileName : input filename
+ * @param record : output detection record
+ * @return false if the file could not be read or is not a detection record
+ */
+bool
+readDetectionRecord(const string& fileName,
+                    DetectionRecord& record) {
+  ifstream in(fileName.c_str(), ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  int count = int(bytes.size() / 4) - 1;
+  if (count < 12 || string(bytes.begin(), bytes.begin() + 4) != "TXSG")
+    return false;
+  std::vector<int> fields(count);
+  for (int it = 0; it < count; it++) {
+    unsigned value = 0;
+    for (int b = 0; b < 4; b++)
+      value |= unsigned((unsigned char)(bytes[4 + 4 * it + b])) << (8 * b);
+    fields[it] = int(value);
+  }
+  int nbSettings = fields[10];
+  if (fields[0] != 2 || nbSettings < 0 || nbSettings > count - 12)
+    return false;
+  int first = 12 + nbSettings; //first segment field
+  if ((count - first) % 4 != 0 || fields[first - 1] != (count - first) / 4)
+    return false;
+  record.width = fields[1];
+  record.height = fields[2];
+  record.content = Rect(fields[3], fields[4], fields[5], fields[6]);
+  record.up = fields[7];
+  record.down = fields[8];
+  record.truncated = (fields[9] & 1) != 0;
+  record.screenedOut = (fields[9] & 2) != 0;
+  record.blank = (fields[9] & 4) != 0;
+  record.settings.assign(fields.begin() + 11, fields.begin() + 11 + nbSettings);
+  record.seg.clear();
+  for (int it = first; it < count; it += 4)
+    record.seg.push_back(make_pair(Pt2i(fields[it], fields[it+1]), Pt2i(fields[it+2], fields[it+3])));
+  return record.up >= 1 && record.down >= 1;
+}
+
+/**
+ * @brief Check that a detection record was saved for a page of the size of an image
+ * @param record : detection record
+ * @param img : input image
+ */
+bool
+isRecordOfPage(const DetectionRecord& record,
+               const Mat& img) {
+  const Rect& box = record.content;
+  return record.width == img.cols && record.height == img.rows
+    && (record.blank || (box.x >= 0 && box.y >= 0 && box.width > 0 && box.height > 0
+                         && box.x + box.width <= img.cols && box.y + box.height <= img.rows));
+}
+
+/**
+ * @brief Extract the tables of a crop of a page
+ * @param img : input color image
+ * @param content : processed crop of the image, aligned in place on the downsampling grid
+ * @param survey : measures of the whole page, with its stroke width and rulings when used
+ * @param params : extraction parameters
+ * @param truncated : set to true when segment detection was stopped by the deadline
+ * @param screenedOut : if not null, set to true when the crop is rejected by the table pre-screen
+ * @param record : if not null, step 1 results saved for the crop, or replayed from it in replay mode
+ * @param counts : if not null, incremented with the work saved by the detection accelerations
+ * @return vector of bounding boxes of tables in input image coordinates
+ */
+vector<pair<Pt2i, Pt2i> >
+processCrop(const Mat& img,
+            Rect& content,
+            const PageSurvey& survey,
+            const ExtractionParams& params,
+            bool& truncated,
+            bool* screenedOut = NULL,
+            DetectionRecord* record = NULL,
+            DetectionCounts* counts = NULL) {
+  bool replay = (params.replay && record != NULL);
+  
+  // Select the working resolution from the whole page size, gray levels are computed on the fly
+  int up, down;
+  if (replay) {
+    content = record->content;
+    up = record->up;
+    down = record->down;
+    truncated = record->truncated;
+  }
+  else {
+    selectWorkingScale(params.stroke > 0 ? survey.strokeWidth : 0, img.cols, img.rows, params.stroke, up, down);
+    alignCropToGrid(content, down);
+    if (record != NULL) {
+      record->content = content;
+      record->up = up;
+      record->down = down;
+    }
+  }
+  Mat crop = img(content);
+  int width = crop.cols;
+  int height = crop.rows;
+  
+  // Pre-screen: pages without long rulings are not processed, the length is scaled from working resolution
+  if (!replay && params.prescreen > 0) {
+    bool rejected = !mayContainTables(survey, (params.prescreen * down + up - 1) / up);
+    if (screenedOut != NULL)
+      *screenedOut = rejected;
+    if (record != NULL)
+      record->screenedOut = rejected;
+    if (rejected)
+      return vector<pair<Pt2i, Pt2i> >();
+  }
+  
+  // Step 1: Line segment detection using FBSD detector, or replay of the saved segments
+  Mat grayImg;
+  Point origin(content.x, content.y);
+  std::vector<std::pair<Pt2i, Pt2i> > areas = mapRoiToWorking(params.roi, up, down, origin);
+  std::vector<std::pair<Pt2i, Pt2i> > seg;
+  if (up == 1) {
+    // Gray conversion, downsampling and gradient computation in a single pass over the rows
+    BufferRows colorRows(crop.ptr<uchar>(0), width, height, int(crop.step[0]), crop.channels());
+    DownSampledRows downSampled(colorRows, down);
+    RowSource& rows = (down > 1 ? (RowSource&) downSampled : (RowSource&) colorRows);
+    if (replay)
+      readGrayRows(rows, grayImg);
+    else
+      seg = detectFromRows(rows, params, areas, grayImg, truncated, counts);
+  }
+  else {
+    cvtColor(crop, grayImg, COLOR_BGR2GRAY);
+    resize(grayImg, grayImg, Size(up*width,up*height), 0, 0, INTER_LINEAR);
+    if (!replay)
+      seg = FBSDDetector(grayImg, params.axisOnly ? params.tolAlign : 0, areas, params.deadline, &truncated, params.tileBudget, params.failureCache, params.seedFilter, params.adaptiveSweep, counts);
+  }
+  if (replay)
+    seg = record->seg;
+  else if (record != NULL) {
+    record->seg = seg;
+    record->truncated = truncated;
+  }
+  
+  //Steps 2 to 6: Table extraction
+  Size pageSize((up*img.cols)/down, (up*img.rows)/down);
+  return mapBoxesToInput(extractTables(grayImg, seg, params, pageSize), up, down, origin);
+}
+
+/**
+ * @brief Extract the tables of a page and highlight them
+ * Blank pages are not processed, the other ones are processed in the bounding box of their ink.
+ * @param img : input color image, the tables are highlighted in place
+ * @param params : extraction parameters
+ * @param truncated : set to true when segment detection was stopped by the deadline
+ * @param screenedOut : if not null, set to true when the page is rejected by the table pre-screen
+ * @param blank : if not null, set to true when the page is blank
+ * @param record : if not null, step 1 results saved for the page, or replayed from it in replay mode
+ * @param counts : if not null, incremented with the work saved by the detection accelerations
+ * @return vector of bounding boxes of tables
+ */
+vector<pair<Pt2i, Pt2i> >
+processPage(Mat& img,
+            const ExtractionParams& params,
+            bool& truncated,
+            bool* screenedOut = NULL,
+            bool* blank = NULL,
+            DetectionRecord* record = NULL,
+            DetectionCounts* counts = NULL) {
+  // Content crop, replayed pages keep the decisions of their detection
+  Rect content(0, 0, img.cols, img.rows);
+  PageSurvey survey;
+  bool blankPage = false, rejected = false;
+  if (params.replay && record != NULL) {
+    blankPage = record->blank;
+    rejected = record->screenedOut;
+    if (screenedOut != NULL)
+      *screenedOut = rejected;
+  }
+  else {
+    // Ink box, stroke width and rulings in a single pass over the rows
+    if (!params.fullPage || params.stroke > 0 || params.prescreen > 0) {
+      BufferRows grayRows(img.ptr<uchar>(0), img.cols, img.rows, int(img.step[0]), img.channels());
+      surveyPage(grayRows, survey, params.stroke > 0, params.prescreen > 0);
+    }
+    if (!params.fullPage) {
+      blankPage = survey.blank;
+      if (!blankPage)
+        content = survey.inkBox;
+    }
+    if (record != NULL) {
+      *record = DetectionRecord();
+      record->width = img.cols;
+      record->height = img.rows;
+      record->content = content;
+      record->blank = blankPage;
+      record->settings = detectionSettings(params);
+    }
+  }
+  if (blank != NULL)
+    *blank = blankPage;
+  
+  //Steps 1 to 6: Table extraction
+  vector<pair<Pt2i, Pt2i> > tables;
+  if (!blankPage && !rejected)
+    tables = processCrop(img, content, survey, params, truncated, screenedOut, record, counts);
+  
+  //Highlight the tables
+  double alpha = 0.5;
+  highlightBoxes(img, tables, alpha);
+  return tables;
+}
+
+/**
+ * @brief Extract the tables of a PNG page read by rows and write the highlighted page by rows
+ * The full resolution color and gray pages are never loaded: the page is decoded once to
+ * survey it (ink bounding box, stroke width and rulings), once to build the gradient map
+ * of the ink bounding box at working resolution, and once to blend the output rows.
+ * Small pages, which are upsampled, are not handled.
+ * @param input : input PNG filename
+ * @param output : output PNG filename
+ * @param params : extraction parameters
+ * @param truncated : set to true when segment detection was stopped by the deadline
+ * @param screenedOut : if not null, set to true when the page is rejected by the table pre-screen
+ * @param blank : if not null, set to true when the page is blank
+ * @param counts : if not null, incremented with the work saved by the detection accelerations
+ * @return 1 if the page is processed, 0 if it is not handled (not a PNG file or small page), -1 on read or write error
+ */
+int
+processPngPage(const string& input,
+               const string& output,
+               const ExtractionParams& params,
+               bool& truncated,
+               bool* screenedOut = NULL,
+               bool* blank = NULL,
+               DetectionCounts* counts = NULL) {
+  PngRowReader reader;
+  if (!reader.open(input))
+    return 0;
+  int width = reader.getWidth();
+  int height = reader.getHeight();
+  
+  // Ink box, stroke width and rulings in a single decoding, blank pages are not processed
+  Rect content(0, 0, width, height);
+  PageSurvey survey;
+  bool blankPage = false;
+  if (!params.fullPage || params.stroke > 0 || params.prescreen > 0) {
+    surveyPage(reader, survey, params.stroke > 0, params.prescreen > 0);
+    if (!reader.open(input))
+      return -1;
+  }
+  if (!params.fullPage) {
+    blankPage = survey.blank;
+    if (!blankPage)
+      content = survey.inkBox;
+  }
+  if (blank != NULL)
+    *blank = blankPage;
   
-  //Display result
-  cv::Mat mask(img.size(), CV_8UC3, cv::Scalar(0, 0, 0));
-  for(int it=0; it<tables.size(); it++) {
-    Pt2i p1 = tables.at(it).first;
-    Pt2i p2 = tables.at(it).second;
-    rectangle(mask, Point(p1.x(), p1.y()), Point(p2.x(), p2.y()), Scalar(255,255,255), -1);
+  vector<pair<Pt2i, Pt2i> > tables;
+  if (!blankPage) {
+    // Select the working resolution from the whole page size
+    int up, down;
+    selectWorkingScale(params.stroke > 0 ? survey.strokeWidth : 0, width, height, params.stroke, up, down);
+    if (up != 1)
+      return 0;
+    alignCropToGrid(content, down);
+    
+    // Pre-screen: pages without long rulings are not processed, the length is scaled from working resolution
+    bool rejected = false;
+    if (params.prescreen > 0) {
+      rejected = !mayContainTables(survey, params.prescreen * down);
+      if (screenedOut != NULL)
+        *screenedOut = rejected;
+    }
+    
+    if (!rejected) {
+      // Step 1: Line segment detection using FBSD detector, the gradient map is
+      // computed while the rows are decoded, cropped and downsampled
+      CroppedRows cropped(reader, content.x, content.y, content.width, content.height);
+      DownSampledRows downSampled(cropped, down);
+      RowSource& rows = (down > 1 ? (RowSource&) downSampled : (RowSource&) cropped);
+      Mat grayImg;
+      Point origin(content.x, content.y);
+      std::vector<std::pair<Pt2i, Pt2i> > areas = mapRoiToWorking(params.roi, 1, down, origin);
+      std::vector<std::pair<Pt2i, Pt2i> > seg = detectFromRows(rows, params, areas, grayImg, truncated, counts);
+      
+      //Steps 2 to 6: Table extraction
+      Size pageSize(width/down, height/down);
+      tables = mapBoxesToInput(extractTables(grayImg, seg, params, pageSize), 1, down, origin);
+    }
   }
+  reader.close();
+  
+  //Highlight the tables row by row
+  PngRowWriter writer;
+  if (!reader.open(input, true) || !writer.open(output, width, height, 3))
+    return -1;
+  std::vector<uchar> row(3*width);
+  std::vector<bool> inside(width);
   double alpha = 0.5;
-  Mat dst;
-  cv::addWeighted(img, alpha, mask, 1.0 - alpha , 0.0, dst);
-  resize(dst, dst, Size(width/scale,height/scale),INTER_LINEAR);
-  imwrite(resFilename, dst);
+  for (int y = 0; y < height; y++) {
+    if (!reader.nextRow(&row[0]))
+      return -1;
+    highlightRow(&row[0], y, width, 3, tables, alpha, inside);
+    if (!writer.writeRow(&row[0]))
+      return -1;
+  }
+  return writer.close() ? 1 : -1;
+}
+
+/**
+ * @brief Print the work saved by the approximate accelerations of the segment detection that are on
+ * @param params : extraction parameters
+ * @param counts : counters of the saved work
+ * @param indent : start of the printed lines
+ */
+void
+printDetectionCounts(const ExtractionParams& params,
+                     const DetectionCounts& counts,
+                     const string& indent) {
+  if (params.failureCache)
+    cout << indent << counts.skippedTrials << " detection trials skipped by the failure cache" << endl;
+  if (params.seedFilter)
+    cout << indent << counts.filteredSeeds << " seeds rejected by the seed pre-filter" << endl;
+}
+
+/**
+ * @brief Page of a batch going through the pipeline stages
+ */
+struct BatchPage {
+  int index = 0;
+  string input, output;
+  Mat img;
+  bool truncated = false;
+  bool screenedOut = false;
+  bool blank = false;
+  DetectionCounts counts;
+};
+
+/**
+ * @brief Read a batch list: one input filename and an optional output filename per line
+ * @param listFile : batch list filename
+ * @param pages : output list of pages (default output is the input name suffixed with _result.png)
+ * @return false if the list could not be read
+ */
+bool
+readBatchList(const string& listFile,
+              vector<BatchPage>& pages) {
+  ifstream in(listFile.c_str());
+  if(!in)
+    return false;
+  string line;
+  while(getline(in, line)) {
+    istringstream fields(line);
+    BatchPage page;
+    if(!(fields >> page.input) || page.input[0] == '#')
+      continue;
+    if(!(fields >> page.output))
+      page.output = fileStem(page.input) + "_result.png";
+    page.index = pages.size();
+    pages.push_back(page);
+  }
+  return true;
+}
+
+/**
+ * @brief Process a batch of pages with overlapping decode, detection and encode stages
+ * One thread decodes the pages, workers extract the tables and one thread encodes the results.
+ * Bounded queues between the stages limit the count of pages held in memory.
+ * @param pages : pages to process
+ * @param params : extraction parameters
+ * @param workers : count of extraction threads
+ * @return count of pages that could not be processed
+ */
+int
+processBatch(vector<BatchPage>& pages,
+             const ExtractionParams& params,
+             int workers) {
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  BoundedQueue<BatchPage> decoded(workers + 1), extracted(workers + 1);
+  std::atomic<int> failures(0), truncations(0), screenings(0), blanks(0);
+  std::atomic<long long> decodeTime(0), extractTime(0), waitTime(0), encodeTime(0);
+  std::mutex logMutex;
+  DetectionCounts counts;
+  
+  // Decode stage
+  std::thread decoder([&]() {
+    for(int it=0; it<pages.size(); it++) {
+      Clock::time_point t0 = Clock::now();
+      BatchPage page = pages.at(it);
+      page.img = imread(page.input, IMREAD_COLOR);
+      decodeTime += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+      if(page.img.cols == 0 || page.img.rows == 0) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        cerr << "Couldn't open the " << page.input << " image file." << endl;
+        failures++;
+        continue;
+      }
+      decoded.push(page);
+    }
+    decoded.close();
+  });
+  
+  // Extraction stage
+  vector<std::thread> extractors;
+  for(int w=0; w<workers; w++)
+    extractors.push_back(std::thread([&]() {
+      BatchPage page;
+      Clock::time_point t0 = Clock::now();
+      while(decoded.pop(page)) {
+        Clock::time_point t1 = Clock::now();
+        waitTime += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+        // Segments saved or replayed next to the input file
+        DetectionRecord record;
+        bool recorded = !params.replay || (readDetectionRecord(recordName(page.input), record) && isRecordOfPage(record, page.img));
+        string mismatch = (recorded && params.replay) ? settingMismatch(record, params) : string();
+        if(recorded && mismatch.empty()) {
+          if(params.pool != NULL)
+            params.pool->enter();
+          processPage(page.img, params, page.truncated, &page.screenedOut, &page.blank,
+                      (params.saveSegments || params.replay) ? &record : NULL, &page.counts);
+          if(params.pool != NULL)
+            params.pool->leave();
+        }
+        if(recorded && params.saveSegments)
+          recorded = writeDetectionRecord(recordName(page.input), record);
+        if(!recorded || !mismatch.empty()) {
+          std::lock_guard<std::mutex> lock(logMutex);
+          if(!mismatch.empty())
+            cerr << "The " << recordName(page.input) << " segment file was saved with another " << mismatch << " setting." << endl;
+          else
+            cerr << "Couldn't " << (params.replay ? "read" : "write") << " the " << recordName(page.input) << " segment file." << endl;
+          failures++;
+        }
+        if(page.truncated) {
+          std::lock_guard<std::mutex> lock(logMutex);
+          cerr << "Segment detection truncated after " << params.deadline << " ms on " << page.input << "." << endl;
+          truncations++;
+        }
+        if(page.screenedOut)
+          screenings++;
+        if(page.blank)
+          blanks++;
+        {
+          std::lock_guard<std::mutex> lock(logMutex);
+          counts.skippedTrials += page.counts.skippedTrials;
+          counts.filteredSeeds += page.counts.filteredSeeds;
+        }
+        t0 = Clock::now();
+        extractTime += std::chrono::duration_cast<std::chrono::microseconds>(t0 - t1).count();
+        if(recorded)
+          extracted.push(page);
+      }
+    }));
+  
+  // Encode stage
+  std::thread encoder([&]() {
+    BatchPage page;
+    while(extracted.pop(page)) {
+      Clock::time_point t0 = Clock::now();
+      bool written = false;
+      string error;
+      try {
+        written = imwrite(page.output, page.img);
+      }
+      catch(const cv::Exception& e) {
+        //Unknown output extension for instance, the other pages are still written
+        error = e.what();
+      }
+      encodeTime += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+      if(!written) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        cerr << "Couldn't write the " << page.output << " image file." << endl;
+        if(!error.empty())
+          cerr << error << endl;
+        failures++;
+      }
+    }
+  });
+  
+  decoder.join();
+  for(int w=0; w<workers; w++)
+    extractors.at(w).join();
+  extracted.close();
+  encoder.join();
+  
+  // Batch statistics
+  double wall = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() / 1000.0;
+  cout << "Processed " << pages.size() - failures << "/" << pages.size() << " pages in " << wall << " s";
+  if(wall > 0)
+    cout << " (" << (pages.size() - failures) / wall << " pages/s)";
+  cout << " with " << workers << " extraction threads" << endl;
+  cout << "  decode " << decodeTime / 1000 << " ms, extraction " << extractTime / 1000
+       << " ms, extraction wait " << waitTime / 1000 << " ms, encode " << encodeTime / 1000 << " ms" << endl;
+  if(truncations > 0)
+    cout << "  " << truncations << " pages truncated by the deadline" << endl;
+  if(blanks > 0)
+    cout << "  " << blanks << " blank pages" << endl;
+  if(params.prescreen > 0 && pages.size() > failures)
+    cout << "  " << screenings << " pages skipped by the table pre-screen ("
+         << 100.0 * screenings / (pages.size() - failures) << " %)" << endl;
+  if(!params.replay)
+    printDetectionCounts(params, counts, "  ");
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  
+  // parse command line using CLI ----------------------------------------------
+  CLI::App app;
+  string imgFileName, resFilename{"result.png"}, batchFile;
+  ExtractionParams params;
+  int jobs = 0;
+  bool streamPng = false;
+  
+  app.add_option("--input,-i,1", imgFileName, "Input filename.");
+  app.add_option("--output,-o,2", resFilename, "Output filename (default = result.png)", true);
+  app.add_option("--window,-w", params.win, "Window size of intensity analysis in working resolution pixels (default = 7) ", true);
+  app.add_option("--angle,-a", params.tolAlign, "Angle tolerance for horizontal and vertical segments (default = 5 degree)", true);
+  app.add_option("--distance,-d", params.tolDistGr, "Max distance to regroupe the segments in working resolution pixels (default = 20)", true);
+  app.add_option("--len,-l", params.tolLen, "Min length of segments in working resolution pixels (default = 30)", true);
+  app.add_option("--ratio,-r", params.ratio, "Ratio for eliminating text segments (default = 0.75)", true);
+  app.add_option("--stroke,-s", params.stroke, "Stroke width kept at working resolution, 0 for full resolution (default = 4)", true);
+  app.add_flag("--axis-only,-x", params.axisOnly, "Detect only segments close to horizontal and vertical directions");
+  app.add_option("--roi", params.roi, "Regions of interest given as x y w h in input image pixels (repeatable)");
+  app.add_option("--deadline-ms", params.deadline, "Time budget of the segment detection in ms, 0 for none (default = 0)", true);
+  app.add_option("--tile-mb", params.tileBudget, "Memory budget of the gradient map of a detection tile in MB, the page itself is not bounded, 0 for no tiles (default = 0)", true);
+  app.add_option("--batch,-b", batchFile, "Batch list file: one input and optional output filename per line");
+  app.add_option("--jobs,-j", jobs, "Extraction threads, shared by the pages and their tasks, 0 for the count of cores (default = 0)", true);
+  app.add_flag("--failure-cache", params.failureCache, "Skip segment seeds close to seeds that already failed (faster, approximate)");
+  app.add_flag("--seed-filter", params.seedFilter, "Skip segment seeds on edges running along the sweep stroke (faster, approximate)");
+  app.add_flag("--adaptive-sweep", params.adaptiveSweep, "Sweep finely only around the long segments found by a coarse sweep (faster, approximate)");
+  app.add_option("--prescreen", params.prescreen, "Min length of the rulings required to search a page for tables, 0 for no pre-screen (default = 0)", true);
+  app.add_flag("--bilevel", params.bilevel, "Bilevel pages: seed the segments from long dark runs instead of sweeping the page");
+  app.add_flag("--full-page", params.fullPage, "Process the whole page instead of the bounding box of its ink");
+  app.add_flag("--stream-png", streamPng, "Read PNG input and write PNG output by rows without loading the full page");
+  app.add_flag("--save-segments", params.saveSegments, "Save the detected segments of each page next to its input file (.seg)");
+  app.add_flag("--replay", params.replay, "Replay the table extraction (steps 2 to 6) from the segments saved next to each input file, with the same step 1 settings");
+  
+  app.get_formatter()->column_width(40);
+  CLI11_PARSE(app, argc, argv);
+  // END parse command line using CLI ----------------------------------------------
+  if (params.roi.size() % 4 != 0) {
+    cerr << "Regions of interest must be given as x y w h." << endl;
+    exit (EXIT_FAILURE);
+  }
+  bool validRoi = params.roi.empty();
+  for(int it=0; it+3<params.roi.size(); it+=4)
+    if(params.roi[it+2] > 0 && params.roi[it+3] > 0)
+      validRoi = true;
+  if (!validRoi) {
+    cerr << "No valid region of interest." << endl;
+    exit (EXIT_FAILURE);
+  }
+  if (params.saveSegments && params.replay) {
+    cerr << "Segments cannot be saved and replayed at once." << endl;
+    exit (EXIT_FAILURE);
+  }
+  
+  // Thread pool shared by the pages and their tasks
+  if (jobs <= 0)
+    jobs = std::max(1, int(std::thread::hardware_concurrency()));
+  TaskPool pool(jobs);
+  params.pool = &pool;
+  
+  // Batch mode
+  if (!batchFile.empty()) {
+    vector<BatchPage> pages;
+    if (!readBatchList(batchFile, pages)) {
+      cerr << "Couldn't open the " << batchFile << " batch file." << endl;
+      exit (EXIT_FAILURE);
+    }
+    int failures = processBatch(pages, params, jobs);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  
+  // Process a PNG page by rows, not with saved or replayed segments
+  bool truncated = false;
+  DetectionCounts counts;
+  if (streamPng && !params.saveSegments && !params.replay) {
+    int status = processPngPage(imgFileName, resFilename, params, truncated, NULL, NULL, &counts);
+    if (status < 0) {
+      cerr << "Couldn't process the " << imgFileName << " PNG file." << endl;
+      exit (EXIT_FAILURE);
+    }
+    if (status > 0) {
+      if (truncated)
+        cerr << "Segment detection truncated after " << params.deadline << " ms on " << imgFileName << "." << endl;
+      printDetectionCounts(params, counts, "");
+      return EXIT_SUCCESS;
+    }
+  }
+  
+  // Load image
+  Mat img = imread(imgFileName, IMREAD_COLOR);
+  if (img.cols == 0 || img.rows == 0) {
+    cerr << "Couldn't open the " << imgFileName << " image file." << endl;
+    exit (EXIT_FAILURE);
+  }
+  
+  // Segments replayed from the file saved next to the input file
+  DetectionRecord record;
+  string recordFile = recordName(imgFileName);
+  if (params.replay && !(readDetectionRecord(recordFile, record) && isRecordOfPage(record, img))) {
+    cerr << "Couldn't read the " << recordFile << " segment file." << endl;
+    exit (EXIT_FAILURE);
+  }
+  string mismatch = params.replay ? settingMismatch(record, params) : string();
+  if (!mismatch.empty()) {
+    cerr << "The " << recordFile << " segment file was saved with another " << mismatch << " setting." << endl;
+    exit (EXIT_FAILURE);
+  }
+  
+  // Extract and highlight the tables
+  processPage(img, params, truncated, NULL, NULL, (params.saveSegments || params.replay) ? &record : NULL, &counts);
+  if (truncated)
+    cerr << "Segment detection truncated after " << params.deadline << " ms on " << imgFileName << "." << endl;
+  if (!params.replay)
+    printDetectionCounts(params, counts, "");
+  if (params.saveSegments && !writeDetectionRecord(recordFile, record)) {
+    cerr << "Couldn't write the " << recordFile << " segment file." << endl;
+    exit (EXIT_FAILURE);
+  }
+  imwrite(resFilename, img);
   
   return EXIT_SUCCESS;
 }